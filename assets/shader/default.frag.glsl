@@ -3,35 +3,107 @@
 // Fragment Shader output
 layout(location = 0) out vec4 fcolor;
 
+// Per-frame camera and light parameters are read from FrameBlock, which
+// glUtil::loadShader prepends
+
 // Light Parameters
-uniform vec3 lightPosition; // light position in eye space
-uniform vec4 Ia; // ambient light color
-uniform vec4 Id; // diffuse light color
-uniform vec4 Is; // specular light color
-
-// Shadow map
-uniform samplerCubeShadow shadowMap; // shadow map texture
-uniform mat4 shadowMapProjection; // light space -> clip space
-
-// Texture sampler
-uniform bool hasTexKa;
-uniform bool hasTexKd;
-uniform bool hasTexKs;
-uniform sampler2D texKa; // ambient texture
-uniform sampler2D texKd; // diffuse texture
-uniform sampler2D texKs; // specular texture
-
-// Material parameters
-uniform vec4 ka; // ambient factor
-uniform vec4 kd; // diffuse factor
-uniform vec4 ks; // specular factor
-uniform float shininess; // shininess exponent
+uniform bool lightInRange; // false if the whole mesh is outside of the light radius
+
+// Additional point lights. Layout must match PointLightBlock.
+const int MAX_POINT_LIGHTS = 32;
+struct PointLight
+{
+	vec4 positionRadius; // position in eye space, influence radius
+	vec4 positionWorld; // position in world space
+	vec4 Id; // diffuse light color
+	vec4 Is; // specular light color
+	ivec4 shadowMap; // shadow map tier (-1 if the light has none), cube map layer and 1 if the visibility is baked
+};
+layout(std140) uniform PointLightBlock
+{
+	PointLight pointLights[MAX_POINT_LIGHTS];
+	int pointLightCount;
+	float pointShadowNear; // near plane of the point light shadow maps
+};
+
+// Shadow maps of the point lights, one cube map array per tier
+uniform samplerCubeArrayShadow pointShadowMaps[4];
+
+// Shadow map. Only the map matching shadowMapType is bound.
+uniform samplerCubeShadow shadowMap; // cube shadow map texture
+uniform sampler2DArrayShadow paraboloidShadowMap; // layer 0 faces +z, layer 1 faces -z
+uniform sampler2DShadow tetrahedralShadowMap; // 2x2 tiles, one per tetrahedron face
+uniform samplerCube momentShadowMap; // prefiltered moments of the cube shadow map
+
+// Values of ShadowMapType
+const int SHADOW_MAP_CUBE = 0;
+const int SHADOW_MAP_DUAL_PARABOLOID = 1;
+const int SHADOW_MAP_TETRAHEDRAL = 2;
+
+// Values of ShadowFilter
+const int SHADOW_FILTER_COMPARE = 0;
+const int SHADOW_FILTER_VSM = 1;
+const int SHADOW_FILTER_EVSM = 2;
+
+// Exponents of the EVSM warp, must match shadowMapMoments.frag
+const float EVSM_POSITIVE_EXPONENT = 40.0;
+const float EVSM_NEGATIVE_EXPONENT = 5.0;
+
+// Mip level of the moment map used as filter kernel
+const float MOMENT_FILTER_LOD = 1.5;
+
+// Moment bounds below this value count as full shadow to reduce light bleeding
+const float LIGHT_BLEEDING_REDUCTION = 0.3;
+
+// Directions of the tetrahedron faces, see ShadowMap::getTetrahedronViewMatrix
+const vec3 tetrahedronDirections[4] = vec3[4](
+	vec3( 1.0,  1.0,  1.0),
+	vec3( 1.0, -1.0, -1.0),
+	vec3(-1.0,  1.0, -1.0),
+	vec3(-1.0, -1.0,  1.0)
+);
+
+// Texture sampler. The layers are selected by the material.
+uniform sampler2DArray texKa; // ambient texture
+uniform sampler2DArray texKd; // diffuse texture
+uniform sampler2DArray texKs; // specular texture
+
+// Parameters of all materials. Material i occupies the texels 4i to 4i+3,
+// laid out as MaterialUniforms.
+uniform samplerBuffer materials;
+
+// Parameters of the material of this fragment, set by fetchMaterial()
+vec4 ka; // ambient factor
+vec4 kd; // diffuse factor
+vec4 ks; // specular factor
+float shininess; // shininess exponent
+vec3 layers; // texture layers of ka, kd and ks, -1 if there is no texture
 
 // Vertex shader input
 smooth in vec4 vpos;           // position in eye space
 smooth in vec4 vposLightSpace; // position in light space
 smooth in vec2 vtexCoords;     // texture coordinates
 smooth in vec3 vnormal;        // normal in eye space, not normalized
+flat in int vmaterial;         // index of the material
+#ifdef BAKED_TEXELS
+smooth in vec4 vbakedVisibility[BAKED_TEXELS]; // baked visibility of the point lights
+#endif
+
+void fetchMaterial()
+{
+	ka = texelFetch(materials, 4 * vmaterial + 0);
+	kd = texelFetch(materials, 4 * vmaterial + 1);
+	ks = texelFetch(materials, 4 * vmaterial + 2);
+	vec4 params = texelFetch(materials, 4 * vmaterial + 3);
+	shininess = params.x;
+	layers = params.yzw;
+}
+
+// Returns the texture color if the material has a texture and the factor otherwise
+vec4 materialColor(sampler2DArray tex, float layer, vec4 factor)
+{
+	return (layer >= 0.0) ? texture(tex, vec3(vtexCoords, layer)) : factor;
+}
 
 // Shadow map computation
 // Returns 0 if fragment is in shadow or 1 otherwise
@@ -46,6 +118,12 @@ float depthTest(vec3 positionLightSpace)
 	
 	// Transform the z value into NDC and map it from [-1,1] to [0,1]
 	float depth = (clipSpace.z / clipSpace.w) * 0.5 + 0.5;
+
+	// The linear distance between the near plane and the light radius
+	if (shadowLinearDepth)
+	{
+		depth = (length(positionLightSpace) - shadowNear) / (lightRadius - shadowNear);
+	}
 	
 	// Compare the depth of the fragment to the depth of the shadow map using he sampler
 	float shadow = texture(shadowMap, vec4(positionLightSpace, depth));
@@ -53,30 +131,227 @@ float depthTest(vec3 positionLightSpace)
 	return shadow;
 }
 
+// Dual paraboloid shadow map lookup
+// Returns 0 if fragment is in shadow or 1 otherwise
+float paraboloidDepthTest(vec3 positionLightSpace)
+{
+	float distance = length(positionLightSpace);
+	vec3 direction = positionLightSpace / distance;
+
+	// The -z hemisphere is rotated by 180 degrees around the y axis
+	float layer = (direction.z >= 0.0) ? 0.0 : 1.0;
+	direction.xz *= (direction.z >= 0.0) ? 1.0 : -1.0;
+
+	// Paraboloid projection with negated x like the shadow pass, the depth is
+	// the linear distance between the near plane and the light radius
+	vec2 texCoords = vec2(-direction.x, direction.y) / (1.0 + direction.z) * 0.5 + 0.5;
+	float depth = (distance - shadowNear) / (lightRadius - shadowNear);
+
+	return texture(paraboloidShadowMap, vec4(texCoords, layer, depth));
+}
+
+// Tetrahedral shadow map lookup
+// Returns 0 if fragment is in shadow or 1 otherwise
+float tetrahedralDepthTest(vec3 positionLightSpace)
+{
+	// The face whose direction is closest to the fragment
+	int face = 0;
+	float maxCos = dot(positionLightSpace, tetrahedronDirections[0]);
+	for (int i = 1; i < 4; ++i)
+	{
+		float cosine = dot(positionLightSpace, tetrahedronDirections[i]);
+		if (cosine > maxCos)
+		{
+			maxCos = cosine;
+			face = i;
+		}
+	}
+
+	// Project into the face and map it into its tile
+	vec4 clipSpace = tetrahedronViewProjections[face] * vec4(positionLightSpace, 1.0);
+	vec3 ndc = clipSpace.xyz / clipSpace.w;
+	vec2 tile = vec2(face % 2, face / 2);
+	vec2 texCoords = (ndc.xy * 0.5 + 0.5 + tile) * 0.5;
+
+	return texture(tetrahedralShadowMap, vec3(texCoords, ndc.z * 0.5 + 0.5));
+}
+
+// Shadow lookup of an additional point light
+// Returns 0 if fragment is in shadow or 1 otherwise
+float pointShadowTest(PointLight light, vec3 positionWorld)
+{
+	vec3 positionLightSpace = positionWorld - light.positionWorld.xyz;
+
+	// Perspective depth of the major axis, same as in depthTest() with the 
+	// near plane and the radius of the point light
+	vec3 absPosLS = abs(positionLightSpace);
+	float majorAxisMagnitude = max(absPosLS.x, max(absPosLS.y, absPosLS.z));
+	float near = pointShadowNear;
+	float far = light.positionRadius.w;
+	float depth = ((far + near) / (far - near) - 2.0 * far * near / ((far - near) * majorAxisMagnitude)) * 0.5 + 0.5;
+
+	// The tier is the same for all fragments of the draw
+	vec4 coords = vec4(positionLightSpace, float(light.shadowMap.y));
+	return texture(pointShadowMaps[light.shadowMap.x], coords, depth);
+}
+
+// Chebyshev upper bound of the visibility of depth given the first two moments
+float chebyshevUpperBound(vec2 moments, float depth, float minVariance)
+{
+	if (depth <= moments.x)
+	{
+		return 1.0;
+	}
+
+	float variance = max(moments.y - moments.x * moments.x, minVariance);
+	float difference = depth - moments.x;
+	float pMax = variance / (variance + difference * difference);
+
+	// Cut off the tail of the bound and rescale the rest to [0,1]
+	return clamp((pMax - LIGHT_BLEEDING_REDUCTION) / (1.0 - LIGHT_BLEEDING_REDUCTION), 0.0, 1.0);
+}
+
+
+// Moment shadow map computation
+// Returns the filtered visibility of the fragment in [0,1]
+float momentDepthTest(vec3 positionLightSpace)
+{
+	float depth = (length(positionLightSpace) - shadowNear) / (lightRadius - shadowNear);
+	depth = clamp(depth, 0.0, 1.0);
+
+	// A single fetch from a blurred mip level is the whole filter
+	vec4 moments = textureLod(momentShadowMap, positionLightSpace, MOMENT_FILTER_LOD);
+
+	if (shadowFilter == SHADOW_FILTER_EVSM)
+	{
+		float warped = depth * 2.0 - 1.0;
+		float positive = exp(EVSM_POSITIVE_EXPONENT * warped);
+		float negative = -exp(-EVSM_NEGATIVE_EXPONENT * warped);
+
+		// Minimum variance scaled by the derivative of the warp
+		float positiveVariance = 0.0001 * EVSM_POSITIVE_EXPONENT * positive;
+		float negativeVariance = 0.0001 * EVSM_NEGATIVE_EXPONENT * negative;
+		float positiveBound = chebyshevUpperBound(moments.xy, positive, positiveVariance * positiveVariance);
+		float negativeBound = chebyshevUpperBound(moments.zw, negative, negativeVariance * negativeVariance);
+		return min(positiveBound, negativeBound);
+	}
+
+	return chebyshevUpperBound(moments.xy, depth, 0.00002);
+}
+
+
+// Returns 0 if fragment is in shadow or 1 otherwise
+float shadowTest(vec3 positionLightSpace)
+{
+	if (shadowMapType == SHADOW_MAP_DUAL_PARABOLOID)
+	{
+		return paraboloidDepthTest(positionLightSpace);
+	}
+	else if (shadowMapType == SHADOW_MAP_TETRAHEDRAL)
+	{
+		return tetrahedralDepthTest(positionLightSpace);
+	}
+	else if (shadowFilter != SHADOW_FILTER_COMPARE)
+	{
+		return momentDepthTest(positionLightSpace);
+	}
+
+	return depthTest(positionLightSpace);
+}
+
+// Ambient Lighting
+vec4 ambientColor()
+{
+	return Ia * materialColor(texKa, layers.x, ka);
+}
+
 // Phong Lighting
 vec4 phong(vec3 N, vec3 L, vec3 V, float shadow)
 {
-	vec4 ambient  = Ia * (hasTexKa ? texture(texKa, vtexCoords) : ka);
-	vec4 diffuse  = Id * (hasTexKd ? texture(texKd, vtexCoords) : kd) * max(dot(N, L), 0.0);
-	vec4 specular = Is * (hasTexKs ? texture(texKs, vtexCoords) : ks) 
+	vec4 ambient  = ambientColor();
+	vec4 diffuse  = Id * materialColor(texKd, layers.y, kd) * max(dot(N, L), 0.0);
+	vec4 specular = Is * materialColor(texKs, layers.z, ks) 
 	                   * pow(max(dot(reflect(-L, N), V), 0.0), shininess)
 	                   * ((dot(N, L) > 0.0) ? 1.0 : 0.0);
 	
 	return ambient + shadow * (diffuse + specular);
 }
 
+// Diffuse and specular light of an additional point light
+vec4 pointLightColor(int index, vec3 N, vec3 V, vec3 positionWorld)
+{
+	PointLight light = pointLights[index];
+	vec3 L = light.positionRadius.xyz - vpos.xyz;
+	float distance = length(L);
+	if (distance > light.positionRadius.w)
+	{
+		return vec4(0.0);
+	}
+	L /= distance;
+
+	// Baked lights read the visibility of the vertices instead, meshes 
+	// which were not baked are not shadowed by them. Other lights without a
+	// shadow map are not shadowed either.
+	float shadow = 1.0;
+	if (light.shadowMap.z != 0)
+	{
+#ifdef BAKED_TEXELS
+		shadow = vbakedVisibility[index / 4][index % 4];
+#endif
+	}
+	else if (light.shadowMap.x >= 0)
+	{
+		shadow = pointShadowTest(light, positionWorld);
+	}
+
+	vec4 diffuse  = light.Id * materialColor(texKd, layers.y, kd) * max(dot(N, L), 0.0);
+	vec4 specular = light.Is * materialColor(texKs, layers.z, ks) 
+	                         * pow(max(dot(reflect(-L, N), V), 0.0), shininess)
+	                         * ((dot(N, L) > 0.0) ? 1.0 : 0.0);
+
+	// The alpha of the fragment is left untouched
+	return vec4(shadow * (diffuse + specular).rgb, 0.0);
+}
+
 void main(void)
 {
-	// Evaluate shadowing
-	float shadow = depthTest(vec3(vposLightSpace));
-	
-	// Compute view, light and normal direction
-	vec3 N = normalize(vnormal);
-	vec3 V = normalize(vec3(0.0) - vpos.xyz);
-	vec3 L = normalize(lightPosition - vpos.xyz);
+	vec4 color;
+
+	fetchMaterial();
+
+	// Meshes outside of the light radius only receive ambient light
+	if (lightInRange)
+	{
+		// Evaluate shadowing
+		float shadow = shadowTest(vec3(vposLightSpace));
+
+		// Fragments outside of the light radius are not lit either
+		shadow *= step(length(vec3(vposLightSpace)), lightRadius);
+		
+		// Compute view, light and normal direction
+		vec3 N = normalize(vnormal);
+		vec3 V = normalize(vec3(0.0) - vpos.xyz);
+		vec3 L = normalize(lightPosition - vpos.xyz);
 
-	// Compute Phong lighting
-	vec4 color = phong(N, L, V, shadow);
+		// Compute Phong lighting
+		color = phong(N, L, V, shadow);
+	}
+	else
+	{
+		color = ambientColor();
+	}
+
+	// Additional point lights
+	if (pointLightCount > 0)
+	{
+		vec3 N = normalize(vnormal);
+		vec3 V = normalize(vec3(0.0) - vpos.xyz);
+		vec3 positionWorld = vec3(vposLightSpace) + lightPositionWorld;
+		for (int i = 0; i < pointLightCount; ++i)
+		{
+			color += pointLightColor(i, N, V, positionWorld);
+		}
+	}
 	
 	// Discard transparent fragments
 	if(color.a == 0.0)
@@ -3,52 +3,140 @@
 // Fragment Shader output
 layout(location = 0) out vec4 fcolor;
 
+// Per-frame camera and light parameters are read from FrameBlock, which
+// glUtil::loadShader prepends
+
 // Light Parameters
-uniform vec3 lightPosition; // light position in eye space
-uniform vec4 Ia; // ambient light color
-uniform vec4 Id; // diffuse light color
-uniform vec4 Is; // specular light color
-
-// Texture sampler
-uniform bool hasTexKa;
-uniform bool hasTexKd;
-uniform bool hasTexKs;
-uniform sampler2D texKa; // ambient texture
-uniform sampler2D texKd; // diffuse texture
-uniform sampler2D texKs; // specular texture
-
-// Material parameters
-uniform vec4 ka; // ambient factor
-uniform vec4 kd; // diffuse factor
-uniform vec4 ks; // specular factor
-uniform float shininess; // shininess exponent
+uniform bool lightInRange; // false if the whole mesh is outside of the light radius
+
+// Additional point lights. Layout must match PointLightBlock.
+const int MAX_POINT_LIGHTS = 32;
+struct PointLight
+{
+	vec4 positionRadius; // position in eye space, influence radius
+	vec4 positionWorld; // position in world space
+	vec4 Id; // diffuse light color
+	vec4 Is; // specular light color
+	ivec4 shadowMap; // shadow map tier (-1 if the light has none) and cube map layer
+};
+layout(std140) uniform PointLightBlock
+{
+	PointLight pointLights[MAX_POINT_LIGHTS];
+	int pointLightCount;
+	float pointShadowNear; // near plane of the point light shadow maps
+};
+
+// Texture sampler. The layers are selected by the material.
+uniform sampler2DArray texKa; // ambient texture
+uniform sampler2DArray texKd; // diffuse texture
+uniform sampler2DArray texKs; // specular texture
+
+// Parameters of all materials. Material i occupies the texels 4i to 4i+3,
+// laid out as MaterialUniforms.
+uniform samplerBuffer materials;
+
+// Parameters of the material of this fragment, set by fetchMaterial()
+vec4 ka; // ambient factor
+vec4 kd; // diffuse factor
+vec4 ks; // specular factor
+float shininess; // shininess exponent
+vec3 layers; // texture layers of ka, kd and ks, -1 if there is no texture
 
 // Vertex shader input
 smooth in vec4 vpos;           // position in eye space
 smooth in vec2 vtexCoords;     // texture coordinates
 smooth in vec3 vnormal;        // normal in eye space, not normalized
+flat in int vmaterial;         // index of the material
+
+void fetchMaterial()
+{
+	ka = texelFetch(materials, 4 * vmaterial + 0);
+	kd = texelFetch(materials, 4 * vmaterial + 1);
+	ks = texelFetch(materials, 4 * vmaterial + 2);
+	vec4 params = texelFetch(materials, 4 * vmaterial + 3);
+	shininess = params.x;
+	layers = params.yzw;
+}
+
+// Returns the texture color if the material has a texture and the factor otherwise
+vec4 materialColor(sampler2DArray tex, float layer, vec4 factor)
+{
+	return (layer >= 0.0) ? texture(tex, vec3(vtexCoords, layer)) : factor;
+}
+
+// Ambient Lighting
+vec4 ambientColor()
+{
+	return Ia * materialColor(texKa, layers.x, ka);
+}
 
 // Phong Lighting
-vec4 phong(vec3 N, vec3 L, vec3 V)
+vec4 phong(vec3 N, vec3 L, vec3 V, float lightFactor)
 {
-	vec4 ambient  = Ia * (hasTexKa ? texture(texKa, vtexCoords) : ka);
-	vec4 diffuse  = Id * (hasTexKd ? texture(texKd, vtexCoords) : kd) * max(dot(N, L), 0.0);
-	vec4 specular = Is * (hasTexKs ? texture(texKs, vtexCoords) : ks) 
+	vec4 ambient  = ambientColor();
+	vec4 diffuse  = Id * materialColor(texKd, layers.y, kd) * max(dot(N, L), 0.0);
+	vec4 specular = Is * materialColor(texKs, layers.z, ks) 
 	                   * pow(max(dot(reflect(-L, N), V), 0.0), shininess)
 	                   * ((dot(N, L) > 0.0) ? 1.0 : 0.0);
 	
-	return ambient + diffuse + specular;
+	return ambient + lightFactor * (diffuse + specular);
+}
+
+// Diffuse and specular light of an additional point light
+vec4 pointLightColor(PointLight light, vec3 N, vec3 V)
+{
+	vec3 L = light.positionRadius.xyz - vpos.xyz;
+	float distance = length(L);
+	if (distance > light.positionRadius.w)
+	{
+		return vec4(0.0);
+	}
+	L /= distance;
+
+	vec4 diffuse  = light.Id * materialColor(texKd, layers.y, kd) * max(dot(N, L), 0.0);
+	vec4 specular = light.Is * materialColor(texKs, layers.z, ks) 
+	                         * pow(max(dot(reflect(-L, N), V), 0.0), shininess)
+	                         * ((dot(N, L) > 0.0) ? 1.0 : 0.0);
+
+	// The alpha of the fragment is left untouched
+	return vec4((diffuse + specular).rgb, 0.0);
 }
 
 void main(void)
 {
-	// Compute view, light and normal direction
-	vec3 N = normalize(vnormal);
-	vec3 V = normalize(vec3(0.0) - vpos.xyz);
-	vec3 L = normalize(lightPosition - vpos.xyz);
+	vec4 color;
+
+	fetchMaterial();
+
+	// Meshes outside of the light radius only receive ambient light
+	if (lightInRange)
+	{
+		// Fragments outside of the light radius are not lit either
+		float lightFactor = step(length(lightPosition - vpos.xyz), lightRadius);
+
+		// Compute view, light and normal direction
+		vec3 N = normalize(vnormal);
+		vec3 V = normalize(vec3(0.0) - vpos.xyz);
+		vec3 L = normalize(lightPosition - vpos.xyz);
+
+		// Compute Phong lighting
+		color = phong(N, L, V, lightFactor);
+	}
+	else
+	{
+		color = ambientColor();
+	}
 
-	// Compute Phong lighting
-	vec4 color = phong(N, L, V);
+	// Additional point lights
+	if (pointLightCount > 0)
+	{
+		vec3 N = normalize(vnormal);
+		vec3 V = normalize(vec3(0.0) - vpos.xyz);
+		for (int i = 0; i < pointLightCount; ++i)
+		{
+			color += pointLightColor(pointLights[i], N, V);
+		}
+	}
 	
 	// Discard transparent fragments
 	if(color.a == 0.0)
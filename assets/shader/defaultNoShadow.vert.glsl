@@ -1,28 +1,48 @@
 #version 400
 
-uniform mat4 projectionMatrix; // eye space -> clip coordinates
-uniform mat4 viewMatrix; // world space -> eye space
-uniform mat4 modelMatrix; // model space -> world space
-uniform mat4 normalMatrix; // model space normal -> eye space normal
+// Per-frame camera and light parameters are read from FrameBlock, which
+// glUtil::loadShader prepends
+
+// Transforms of all scene nodes. Node i occupies the texels 8i to 8i+7, 
+// one column per texel: the model matrix followed by the normal matrix.
+uniform samplerBuffer transforms;
+
+mat4 fetchTransform(int offset)
+{
+	return mat4(
+		texelFetch(transforms, offset + 0),
+		texelFetch(transforms, offset + 1),
+		texelFetch(transforms, offset + 2),
+		texelFetch(transforms, offset + 3)
+	);
+}
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 texCoords;
+layout(location = 3) in uvec2 drawID; // index of the node transform and of the material
 
 smooth out vec4 vpos; // position in eye space
 smooth out vec3 vnormal; // normal in eye space, not normalized
 smooth out vec2 vtexCoords; // texture coordinates
+flat out int vmaterial; // index of the material
 
 void main(void)
 {
+	mat4 modelMatrix = fetchTransform(8 * int(drawID.x)); // model space -> world space
+	mat4 normalMatrix = fetchTransform(8 * int(drawID.x) + 4); // model space normal -> world space normal
+
 	// The position in eye space.
 	vpos = viewMatrix * modelMatrix * vec4(position, 1);
 	
 	// The normal in eye space.
-	vnormal = mat3(normalMatrix) * normal;
+	vnormal = mat3(viewMatrix) * mat3(normalMatrix) * normal;
 
 	// The texture coordinates
 	vtexCoords = texCoords;
+
+	// The material is looked up in the fragment shader
+	vmaterial = int(drawID.y);
 	
 	// The position in clip space
 	gl_Position = projectionMatrix * vpos;
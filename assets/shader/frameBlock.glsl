@@ -0,0 +1,19 @@
+// Per-frame camera and light parameters. Layout must match FrameUniforms.
+// Prepended to every shader by glUtil::loadShader.
+layout(std140) uniform FrameBlock
+{
+	mat4 projectionMatrix; // eye space -> clip coordinates
+	mat4 viewMatrix; // world space -> eye space
+	mat4 shadowMapProjection; // light space -> clip space
+	vec3 lightPosition; // light position in eye space
+	float lightRadius; // influence radius of the light
+	vec3 lightPositionWorld; // position of the light in world space
+	vec4 Ia; // ambient light color
+	vec4 Id; // diffuse light color
+	vec4 Is; // specular light color
+	mat4 tetrahedronViewProjections[4]; // light space -> clip space of each tetrahedron face
+	int shadowMapType; // ShadowMapType of the light
+	float shadowNear; // near plane of the shadow map
+	bool shadowLinearDepth; // the cube shadow map stores the normalized linear distance
+	int shadowFilter; // ShadowFilter of the cube shadow map
+};
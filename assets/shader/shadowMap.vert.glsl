@@ -1,11 +1,31 @@
 #version 400
 
-uniform mat4 modelViewProjection; // model space -> clip space
+uniform mat4 viewProjection; // world space -> clip space of the cube map face
+
+// Transforms of all scene nodes. Node i occupies the texels 8i to 8i+7, 
+// one column per texel: the model matrix followed by the normal matrix.
+uniform samplerBuffer transforms;
+
+mat4 fetchTransform(int offset)
+{
+	return mat4(
+		texelFetch(transforms, offset + 0),
+		texelFetch(transforms, offset + 1),
+		texelFetch(transforms, offset + 2),
+		texelFetch(transforms, offset + 3)
+	);
+}
 
 layout(location = 0) in vec3 position;
+layout(location = 3) in uvec2 drawID; // index of the node transform and of the material
+
+smooth out vec3 vpositionWorld; // position in world space, used for linear depth
 
 void main(void)
 {
+	mat4 modelMatrix = fetchTransform(8 * int(drawID.x));
+	vpositionWorld = vec3(modelMatrix * vec4(position, 1.0));
+
 	// The position in clip space
-    gl_Position = modelViewProjection * vec4(position, 1.0);
+    gl_Position = viewProjection * vec4(vpositionWorld, 1.0);
 }
\ No newline at end of file
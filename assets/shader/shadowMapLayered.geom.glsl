@@ -0,0 +1,48 @@
+#version 400
+
+// One invocation per cube map face
+layout(triangles, invocations = 6) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+uniform mat4 faceViewProjections[6]; // world space -> clip space of each cube map face
+uniform int faceMask; // bit i is set if face i is rendered
+
+smooth out vec3 vpositionWorld; // position in world space, used for linear depth
+
+void main(void)
+{
+	int face = gl_InvocationID;
+	if ((faceMask & (1 << face)) == 0)
+	{
+		return;
+	}
+
+	vec4 clipSpace[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		clipSpace[i] = faceViewProjections[face] * gl_in[i].gl_Position;
+	}
+
+	// Skip triangles which are entirely outside of one of the frustum planes
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (clipSpace[0][axis] > clipSpace[0].w && clipSpace[1][axis] > clipSpace[1].w && clipSpace[2][axis] > clipSpace[2].w)
+		{
+			return;
+		}
+		if (clipSpace[0][axis] < -clipSpace[0].w && clipSpace[1][axis] < -clipSpace[1].w && clipSpace[2][axis] < -clipSpace[2].w)
+		{
+			return;
+		}
+	}
+
+	// Route the triangle to the layer of the face
+	for (int i = 0; i < 3; ++i)
+	{
+		gl_Layer = face;
+		gl_Position = clipSpace[i];
+		vpositionWorld = gl_in[i].gl_Position.xyz;
+		EmitVertex();
+	}
+	EndPrimitive();
+}
@@ -0,0 +1,26 @@
+#version 400
+
+// Transforms of all scene nodes. Node i occupies the texels 8i to 8i+7, 
+// one column per texel: the model matrix followed by the normal matrix.
+uniform samplerBuffer transforms;
+
+mat4 fetchTransform(int offset)
+{
+	return mat4(
+		texelFetch(transforms, offset + 0),
+		texelFetch(transforms, offset + 1),
+		texelFetch(transforms, offset + 2),
+		texelFetch(transforms, offset + 3)
+	);
+}
+
+layout(location = 0) in vec3 position;
+layout(location = 3) in uvec2 drawID; // index of the node transform and of the material
+
+void main(void)
+{
+	mat4 modelMatrix = fetchTransform(8 * int(drawID.x));
+
+	// The position in world space, projected per face by the geometry shader
+	gl_Position = modelMatrix * vec4(position, 1.0);
+}
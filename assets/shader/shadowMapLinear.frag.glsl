@@ -0,0 +1,25 @@
+#version 400
+
+// Per-frame camera and light parameters are read from FrameBlock, which
+// glUtil::loadShader prepends
+
+// glPolygonOffset has no effect on a written depth and is applied here with 
+// the same semantics: factor times the depth slope plus units times the 
+// smallest resolvable difference of the 16 bit depth format
+uniform vec2 depthOffset; // factor, units
+
+smooth in vec3 vpositionWorld; // position in world space
+
+// Fragment Shader output
+layout(location = 0) out vec4 fcolor;
+
+void main(void)
+{
+	// The linear distance between the near plane and the light radius
+	float depth = (length(vpositionWorld - lightPositionWorld) - shadowNear) / (lightRadius - shadowNear);
+
+	float slope = max(abs(dFdx(depth)), abs(dFdy(depth)));
+	gl_FragDepth = clamp(depth + depthOffset.x * slope + depthOffset.y / 65535.0, 0.0, 1.0);
+
+	fcolor = vec4(1.0);
+}
@@ -0,0 +1,37 @@
+#version 400
+
+// Per-frame camera and light parameters are read from FrameBlock, which
+// glUtil::loadShader prepends
+
+// Values of ShadowFilter
+const int SHADOW_FILTER_VSM = 1;
+const int SHADOW_FILTER_EVSM = 2;
+
+// Exponents of the EVSM warp, must match the renderer
+const float EVSM_POSITIVE_EXPONENT = 40.0;
+const float EVSM_NEGATIVE_EXPONENT = 5.0;
+
+smooth in vec3 vpositionWorld; // position in world space
+
+// Fragment Shader output
+layout(location = 0) out vec4 fmoments;
+
+void main(void)
+{
+	// The linear distance between the near plane and the light radius
+	float depth = (length(vpositionWorld - lightPositionWorld) - shadowNear) / (lightRadius - shadowNear);
+	depth = clamp(depth, 0.0, 1.0);
+
+	if (shadowFilter == SHADOW_FILTER_EVSM)
+	{
+		// The warped depth in [-1, 1] raised to a positive and a negative exponential
+		float warped = depth * 2.0 - 1.0;
+		float positive = exp(EVSM_POSITIVE_EXPONENT * warped);
+		float negative = -exp(-EVSM_NEGATIVE_EXPONENT * warped);
+		fmoments = vec4(positive, positive * positive, negative, negative * negative);
+	}
+	else
+	{
+		fmoments = vec4(depth, depth * depth, 0.0, 0.0);
+	}
+}
@@ -0,0 +1,47 @@
+#version 400
+
+// Per-frame camera and light parameters are read from FrameBlock, which
+// glUtil::loadShader prepends
+
+uniform float hemisphere; // 1 for the +z hemisphere, -1 for the -z hemisphere
+
+// Transforms of all scene nodes. Node i occupies the texels 8i to 8i+7, 
+// one column per texel: the model matrix followed by the normal matrix.
+uniform samplerBuffer transforms;
+
+mat4 fetchTransform(int offset)
+{
+	return mat4(
+		texelFetch(transforms, offset + 0),
+		texelFetch(transforms, offset + 1),
+		texelFetch(transforms, offset + 2),
+		texelFetch(transforms, offset + 3)
+	);
+}
+
+layout(location = 0) in vec3 position;
+layout(location = 3) in uvec2 drawID; // index of the node transform and of the material
+
+void main(void)
+{
+	mat4 modelMatrix = fetchTransform(8 * int(drawID.x));
+
+	// The position in light space
+	vec3 positionLightSpace = vec3(modelMatrix * vec4(position, 1.0)) - lightPositionWorld;
+	float distance = length(positionLightSpace);
+	vec3 direction = positionLightSpace / distance;
+
+	// The -z hemisphere is rotated by 180 degrees around the y axis
+	direction.xz *= hemisphere;
+
+	// Paraboloid projection, the depth is the linear distance between the
+	// near plane and the light radius. The hemisphere is seen from the light
+	// looking along +z, so x is negated to keep the winding order of the 
+	// cube map faces.
+	float depth = (distance - shadowNear) / (lightRadius - shadowNear);
+	vec2 projected = direction.xy / (1.0 + direction.z);
+	gl_Position = vec4(-projected.x, projected.y, depth * 2.0 - 1.0, 1.0);
+
+	// Vertices of the other hemisphere are clipped
+	gl_ClipDistance[0] = direction.z;
+}
@@ -0,0 +1,76 @@
+#include "renderQueue.hpp"
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+
+// Measures building and sorting a render queue with 100k draws
+int main()
+{
+	size_t const numDraws = 100000;
+	unsigned const numIterations = 100;
+
+	// Random draws with a realistic number of distinct states
+	struct Draw
+	{
+		uint32_t program;
+		uint32_t material;
+		uint32_t vertexArray;
+		float depth;
+	};
+
+	std::mt19937 random(42);
+	std::uniform_int_distribution<uint32_t> programDistribution(1, 4);
+	std::uniform_int_distribution<uint32_t> materialDistribution(1, 256);
+	std::uniform_int_distribution<uint32_t> vertexArrayDistribution(1, 4096);
+	std::uniform_real_distribution<float> depthDistribution(0.f, 100.f);
+
+	std::vector<Draw> draws(numDraws);
+	for (Draw& draw : draws)
+	{
+		draw = { programDistribution(random), materialDistribution(random), vertexArrayDistribution(random), depthDistribution(random) };
+	}
+
+	RenderQueue queue;
+	double buildTime = 0.0;
+	double sortTime = 0.0;
+	for (unsigned iteration = 0; iteration < numIterations; ++iteration)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		queue.clear();
+		for (uint32_t i = 0; i < numDraws; ++i)
+		{
+			Draw const& draw = draws[i];
+			queue.push(RenderQueue::makeKey(1, draw.program, draw.material, draw.vertexArray, draw.depth, 100.f), i);
+		}
+
+		auto built = std::chrono::high_resolution_clock::now();
+		queue.sort();
+		auto sorted = std::chrono::high_resolution_clock::now();
+
+		buildTime += std::chrono::duration<double, std::milli>(built - start).count();
+		sortTime += std::chrono::duration<double, std::milli>(sorted - built).count();
+	}
+
+	// Check the order of the last iteration
+	std::vector<RenderQueue::Item> const& items = queue.getItems();
+	for (size_t i = 1; i < items.size(); ++i)
+	{
+		if (items[i - 1].key > items[i].key)
+		{
+			std::cerr << "Render queue is not sorted at item " << i << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << "Draws:      " << numDraws << std::endl;
+	std::cout << "Iterations: " << numIterations << std::endl;
+	std::cout << "Build:      " << buildTime / numIterations << " ms" << std::endl;
+	std::cout << "Sort:       " << sortTime / numIterations << " ms" << std::endl;
+
+	return 0;
+}
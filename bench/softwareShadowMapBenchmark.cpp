@@ -0,0 +1,207 @@
+#include "softwareShadowMap.hpp"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+
+// Same view and projection as glUtil::ShadowMap for face
+// GL_TEXTURE_CUBE_MAP_POSITIVE_X + face
+static glm::mat4 getFaceViewProjection(int face, glm::vec3 position, float near, float far)
+{
+	glm::vec3 const viewDirections[6] = {
+		glm::vec3( 1,  0,  0), glm::vec3(-1,  0,  0),
+		glm::vec3( 0,  1,  0), glm::vec3( 0, -1,  0),
+		glm::vec3( 0,  0,  1), glm::vec3( 0,  0, -1),
+	};
+	glm::vec3 const upDirections[6] = {
+		glm::vec3( 0,  1,  0), glm::vec3( 0,  1,  0),
+		glm::vec3( 0,  0, -1), glm::vec3( 0,  0,  1),
+		glm::vec3( 0,  1,  0), glm::vec3( 0,  1,  0),
+	};
+
+	glm::mat4 view = glm::lookAt(position, position + viewDirections[face], -upDirections[face]);
+	return glm::perspective(glm::radians(90.0f), 1.0f, near, far) * view;
+}
+
+// Appends a grid of quads in the xz plane at height y
+static void appendFloor(std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices, float halfExtent, float y, uint32_t cells)
+{
+	uint32_t first = static_cast<uint32_t>(positions.size());
+	for (uint32_t z = 0; z <= cells; ++z)
+	{
+		for (uint32_t x = 0; x <= cells; ++x)
+		{
+			float u = static_cast<float>(x) / static_cast<float>(cells) * 2.f - 1.f;
+			float v = static_cast<float>(z) / static_cast<float>(cells) * 2.f - 1.f;
+			positions.push_back(glm::vec3(u * halfExtent, y, v * halfExtent));
+		}
+	}
+
+	// Counterclockwise seen from above
+	for (uint32_t z = 0; z < cells; ++z)
+	{
+		for (uint32_t x = 0; x < cells; ++x)
+		{
+			uint32_t i = first + z * (cells + 1) + x;
+			indices.insert(indices.end(), { i, i + cells + 1, i + 1, i + 1, i + cells + 1, i + cells + 2 });
+		}
+	}
+}
+
+// Appends a closed cylinder around the y axis at the position
+static void appendColumn(std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices, glm::vec3 base, float radius, float height, uint32_t segments, uint32_t stacks)
+{
+	uint32_t first = static_cast<uint32_t>(positions.size());
+	for (uint32_t stack = 0; stack <= stacks; ++stack)
+	{
+		for (uint32_t segment = 0; segment < segments; ++segment)
+		{
+			float angle = 6.2831853f * static_cast<float>(segment) / static_cast<float>(segments);
+			float y = height * static_cast<float>(stack) / static_cast<float>(stacks);
+			positions.push_back(base + glm::vec3(radius * std::cos(angle), y, -radius * std::sin(angle)));
+		}
+	}
+
+	// Counterclockwise seen from outside
+	for (uint32_t stack = 0; stack < stacks; ++stack)
+	{
+		for (uint32_t segment = 0; segment < segments; ++segment)
+		{
+			uint32_t next = (segment + 1) % segments;
+			uint32_t i0 = first + stack * segments + segment;
+			uint32_t i1 = first + stack * segments + next;
+			uint32_t i2 = first + (stack + 1) * segments + segment;
+			uint32_t i3 = first + (stack + 1) * segments + next;
+			indices.insert(indices.end(), { i0, i1, i2, i1, i3, i2 });
+		}
+	}
+}
+
+// Reads the positions and indices of all shapes of an obj file
+static bool readObj(std::string const& path, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+{
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warning, error;
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warning, &error, path.c_str(), nullptr))
+	{
+		std::cerr << warning << error << std::endl;
+		return false;
+	}
+
+	for (size_t i = 0; i + 2 < attrib.vertices.size(); i += 3)
+	{
+		positions.push_back(glm::vec3(attrib.vertices[i], attrib.vertices[i + 1], attrib.vertices[i + 2]));
+	}
+	for (tinyobj::shape_t const& shape : shapes)
+	{
+		for (tinyobj::index_t const& index : shape.mesh.indices)
+		{
+			indices.push_back(static_cast<uint32_t>(index.vertex_index));
+		}
+	}
+
+	return true;
+}
+
+// Measures rendering the six faces of a cube shadow map on the CPU. Renders
+// the obj file given as argument, e.g. sponza.obj, or a generated scene of
+// about the same triangle count.
+int main(int argc, char* argv[])
+{
+	int const size = 2048;
+	unsigned const numIterations = 20;
+
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	if (argc > 1)
+	{
+		if (!readObj(argv[1], positions, indices))
+		{
+			return 1;
+		}
+	}
+	else
+	{
+		// Floor, ceiling and two rows of columns
+		appendFloor(positions, indices, 15.f, 0.f, 256);
+		for (int i = 0; i < 12; ++i)
+		{
+			float x = -11.f + 2.f * static_cast<float>(i);
+			appendColumn(positions, indices, glm::vec3(x, 0.f, -4.f), 0.4f, 10.f, 64, 32);
+			appendColumn(positions, indices, glm::vec3(x, 0.f, 4.f), 0.4f, 10.f, 64, 32);
+		}
+	}
+
+	// The light is placed in the middle of the scene
+	glm::vec3 min(INFINITY);
+	glm::vec3 max(-INFINITY);
+	for (glm::vec3 const& position : positions)
+	{
+		min = glm::min(min, position);
+		max = glm::max(max, position);
+	}
+	glm::vec3 center = 0.5f * (min + max);
+	glm::vec3 lightPosition(center.x, min.y + 0.25f * (max.y - min.y), center.z);
+	float near = 0.1f;
+	float far = glm::length(max - min);
+
+	std::array<glm::mat4, 6> faceViewProjections;
+	for (int face = 0; face < 6; ++face)
+	{
+		faceViewProjections[static_cast<size_t>(face)] = getFaceViewProjection(face, lightPosition, near, far);
+	}
+
+	SoftwareShadowMap shadowMap;
+	shadowMap.init(size);
+	shadowMap.addMesh(positions.data(), sizeof(glm::vec3), positions.size(), indices, glm::mat4(1.f));
+	shadowMap.setCullFace(SoftwareShadowMap::CULL_BACK);
+
+	// Without offset the center of the -y face holds the depth of the point
+	// below the light, which lies on the floor of the generated scene
+	if (argc <= 1)
+	{
+		shadowMap.setPolygonOffset(0.f, 0.f);
+		shadowMap.render(faceViewProjections);
+
+		glm::vec4 clip = faceViewProjections[3] * glm::vec4(lightPosition.x, 0.f, lightPosition.z, 1.f);
+		float expected = clip.z / clip.w * 0.5f + 0.5f;
+		float depth = shadowMap.getFace(3)[(size / 2) * size + size / 2];
+		if (std::abs(depth - expected) > 1e-5f)
+		{
+			std::cerr << "Depth below the light is " << depth << " instead of " << expected << std::endl;
+			return 1;
+		}
+	}
+
+	// Default bias of the renderer
+	shadowMap.setPolygonOffset(1.f, 500.f);
+
+	double renderTime = 0.0;
+	for (unsigned iteration = 0; iteration < numIterations; ++iteration)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		shadowMap.render(faceViewProjections);
+		auto end = std::chrono::high_resolution_clock::now();
+		renderTime += std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	std::cout << "Triangles:  " << shadowMap.getTriangleCount() << std::endl;
+	std::cout << "Rasterized: " << shadowMap.getRasterizedTriangleCount() << std::endl;
+	std::cout << "Face size:  " << size << std::endl;
+	std::cout << "Iterations: " << numIterations << std::endl;
+	std::cout << "Render:     " << renderTime / numIterations << " ms" << std::endl;
+
+	return 0;
+}
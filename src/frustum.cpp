@@ -0,0 +1,51 @@
+#include "frustum.hpp"
+
+#include <glm/glm.hpp>
+
+
+Frustum::Frustum(glm::mat4 const& viewProjection)
+{
+	// Rows of the matrix (glm matrices are stored column major)
+	glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	// Gribb/Hartmann plane extraction for OpenGL clip space
+	planes[0] = row3 + row0; // left
+	planes[1] = row3 - row0; // right
+	planes[2] = row3 + row1; // bottom
+	planes[3] = row3 - row1; // top
+	planes[4] = row3 + row2; // near
+	planes[5] = row3 - row2; // far
+
+	for (glm::vec4& plane : planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
+bool Frustum::intersects(BoundingBox const& box) const
+{
+	if (box.isEmpty())
+	{
+		return false;
+	}
+
+	for (glm::vec4 const& plane : planes)
+	{
+		// Corner of the box which is furthest along the plane normal
+		glm::vec3 positiveVertex(
+			plane.x >= 0.f ? box.max.x : box.min.x,
+			plane.y >= 0.f ? box.max.y : box.min.y,
+			plane.z >= 0.f ? box.max.z : box.min.z
+		);
+
+		if (glm::dot(glm::vec3(plane), positiveVertex) + plane.w < 0.f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
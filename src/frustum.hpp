@@ -0,0 +1,23 @@
+#pragma once
+
+#include "scene/boundingBox.hpp"
+
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <array>
+
+
+// View frustum described by six planes pointing inwards
+struct Frustum
+{
+	// Extracts the frustum planes from a (projection * view) matrix
+	Frustum(glm::mat4 const& viewProjection);
+
+	// Returns false if the box is completely outside of the frustum. May 
+	// return true for boxes which are close to but outside of the frustum.
+	bool intersects(BoundingBox const& box) const;
+
+	// Planes in world space (xyz = normal, w = distance)
+	std::array<glm::vec4, 6> planes;
+};
@@ -1,3 +1,4 @@
+#include "log.hpp"
 #include "gameObject/gameObject.hpp"
 #include "scene/primitive.hpp"
 
@@ -29,7 +30,8 @@ LightSphere::LightSphere(SceneGraph* sceneGraph, size_t parentNode, glm::vec3 po
 		glm::vec3(10.f, 10.f, 0.f),
 		glm::vec4(0.5f),
 		glm::vec4(0.8f),
-		glm::vec4(0.6f))
+		glm::vec4(0.6f),
+		25.f)
 {
 	// Create the material
 	Material* sphereMaterial = sceneGraph->takeMaterial(std::move(std::make_unique<Material>(
@@ -39,7 +41,8 @@ LightSphere::LightSphere(SceneGraph* sceneGraph, size_t parentNode, glm::vec3 po
 		1.f, 1.f)));
 
 	// Create the geometry
-	m_sphereNode = m_sceneGraph->addNode(m_parentNode, false, glm::translate(m_spherePosition));
+	// The sphere moves with the light, so it is a dynamic node
+	m_sphereNode = m_sceneGraph->addNode(m_parentNode, false, glm::translate(m_spherePosition), false);
 	std::vector<Vertex> verts;
 	std::vector<uint32_t> inds;
 	createSphere(0.05f, 40, 40, verts, inds);
@@ -90,6 +93,29 @@ void LightSphere::update(float deltaTimeSeconds)
 		m_animate = !m_animate;
 	}
 
+	// Cycle through the shadow map types of the light
+	if (m_input->isPushed(GLFW_KEY_Z))
+	{
+		switch (m_lightSource.shadowMapType)
+		{
+		default:
+		case SHADOW_MAP_CUBE:
+			m_lightSource.setShadowMapType(SHADOW_MAP_DUAL_PARABOLOID);
+			SPDLOG_DEBUG("Light uses a dual paraboloid shadow map");
+			break;
+
+		case SHADOW_MAP_DUAL_PARABOLOID:
+			m_lightSource.setShadowMapType(SHADOW_MAP_TETRAHEDRAL);
+			SPDLOG_DEBUG("Light uses a tetrahedral shadow map");
+			break;
+
+		case SHADOW_MAP_TETRAHEDRAL:
+			m_lightSource.setShadowMapType(SHADOW_MAP_CUBE);
+			SPDLOG_DEBUG("Light uses a cube shadow map");
+			break;
+		}
+	}
+
 	if (m_animate)
 	{
 		// Compute new position
@@ -103,7 +129,7 @@ void LightSphere::update(float deltaTimeSeconds)
 
 		// Update position
 		m_sceneGraph->setNodeTransformation(m_sphereNode, glm::translate(m_spherePosition));
-		m_lightSource.position = m_spherePosition;
+		m_lightSource.setPosition(m_spherePosition);
 	}
 	else
 	{
@@ -145,6 +171,6 @@ void LightSphere::update(float deltaTimeSeconds)
 		m_sceneGraph->setNodeTransformation(m_sphereNode, glm::translate(m_spherePosition));
 
 		// Update the position of the actual light source
-		m_lightSource.position = m_spherePosition;
+		m_lightSource.setPosition(m_spherePosition);
 	}
 }
@@ -0,0 +1,122 @@
+#include "geometryArena.hpp"
+
+#include "log.hpp"
+#include "glUtil.hpp"
+
+#include <cstddef>
+
+
+GeometryArena::GeometryArena()
+	: m_meshes()
+	, m_ranges()
+	, m_vertexCount(0)
+	, m_indexCount(0)
+	, m_vertexArrayObject(0)
+	, m_vertexBuffer(0)
+	, m_indexBuffer(0)
+{
+}
+
+GeometryArena::~GeometryArena()
+{
+	release();
+}
+
+bool GeometryArena::contains(Mesh const* mesh) const
+{
+	return m_ranges.count(mesh) != 0;
+}
+
+void GeometryArena::add(Mesh const* mesh)
+{
+	if (contains(mesh))
+	{
+		return;
+	}
+
+	Range range = {};
+	range.firstIndex = m_indexCount;
+	range.indexCount = static_cast<uint32_t>(mesh->indices.size());
+	range.baseVertex = static_cast<int32_t>(m_vertexCount);
+	m_ranges[mesh] = range;
+	m_meshes.push_back(mesh);
+
+	m_vertexCount += static_cast<uint32_t>(mesh->vertices.size());
+	m_indexCount += range.indexCount;
+}
+
+void GeometryArena::upload(GLuint instanceBuffer)
+{
+	release();
+
+	SPDLOG_DEBUG("Uploading geometry arena: {} meshes, {} vertices, {} indices", m_meshes.size(), m_vertexCount, m_indexCount);
+
+	glGenVertexArrays(1, &m_vertexArrayObject);
+	glBindVertexArray(m_vertexArrayObject);
+
+	// Interleaved vertex attributes, same locations as Vertex::createVertexArrayObject
+	glGenBuffers(1, &m_vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_vertexCount * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+	for (Mesh const* mesh : m_meshes)
+	{
+		GLintptr offset = m_ranges.at(mesh).baseVertex * static_cast<GLintptr>(sizeof(Vertex));
+		glBufferSubData(GL_ARRAY_BUFFER, offset, static_cast<GLsizeiptr>(mesh->vertices.size() * sizeof(Vertex)), mesh->vertices.data());
+	}
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, position));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, textureCoordinates));
+	glEnableVertexAttribArray(2);
+
+	// The draw id is selected by the base instance of each draw
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribIPointer(glUtil::DRAW_ID_ATTRIBUTE, 3, GL_UNSIGNED_INT, sizeof(glUtil::DrawInstance), 0);
+	glEnableVertexAttribArray(glUtil::DRAW_ID_ATTRIBUTE);
+	glVertexAttribDivisor(glUtil::DRAW_ID_ATTRIBUTE, 1);
+
+	glGenBuffers(1, &m_indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indexCount * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+	for (Mesh const* mesh : m_meshes)
+	{
+		GLintptr offset = m_ranges.at(mesh).firstIndex * static_cast<GLintptr>(sizeof(uint32_t));
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, static_cast<GLsizeiptr>(mesh->indices.size() * sizeof(uint32_t)), mesh->indices.data());
+	}
+
+	// Unbind the vertex array
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GeometryArena::Range const& GeometryArena::getRange(Mesh const* mesh) const
+{
+	return m_ranges.at(mesh);
+}
+
+GLuint GeometryArena::getVertexArrayObject() const
+{
+	return m_vertexArrayObject;
+}
+
+void GeometryArena::release()
+{
+	if (m_vertexArrayObject != 0)
+	{
+		glDeleteVertexArrays(1, &m_vertexArrayObject);
+		m_vertexArrayObject = 0;
+	}
+
+	if (m_vertexBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_vertexBuffer);
+		m_vertexBuffer = 0;
+	}
+
+	if (m_indexBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_indexBuffer);
+		m_indexBuffer = 0;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "scene/mesh.hpp"
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+
+// Vertices and indices of many meshes in one vertex array. Draws of meshes 
+// within the arena can be merged into multi draw calls.
+class GeometryArena
+{
+public:
+	// Location of a mesh within the arena buffers
+	struct Range
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		int32_t baseVertex;
+	};
+
+	GeometryArena();
+	~GeometryArena();
+
+	// Returns true if the mesh has been added
+	bool contains(Mesh const* mesh) const;
+
+	// Appends the geometry of the mesh. Takes effect after upload().
+	void add(Mesh const* mesh);
+
+	// Uploads the geometry of all added meshes and (re)creates the vertex
+	// array. The draw id attribute is read from instanceBuffer.
+	void upload(GLuint instanceBuffer);
+
+	Range const& getRange(Mesh const* mesh) const;
+
+	// Vertex array of all uploaded meshes, 0 before the first upload()
+	GLuint getVertexArrayObject() const;
+
+private:
+	void release();
+
+	// Meshes in the order of their ranges. The geometry is read from the
+	// host copies of the meshes, the arena keeps none of its own.
+	std::vector<Mesh const*> m_meshes;
+	std::unordered_map<Mesh const*, Range> m_ranges;
+	uint32_t m_vertexCount;
+	uint32_t m_indexCount;
+
+	GLuint m_vertexArrayObject;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+};
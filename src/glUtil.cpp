@@ -3,17 +3,20 @@
 #include "log.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <vector>
 #include <fstream>
+#include <utility>
+#include <algorithm>
 #include <sstream>
 #include <iostream>
 
 
-GLuint glUtil::loadShader(char const *path, GLenum shaderType)
+// Declarations shared by all shaders, inserted after the #version line
+static char const* const SHADER_PRELUDE_PATH = "assets/shader/frameBlock.glsl";
+
+GLuint glUtil::loadShader(char const *path, GLenum shaderType, std::string const& defines)
 {
 	// Create a shader object
 	GLuint shader = glCreateShader(shaderType);
@@ -33,6 +36,24 @@ GLuint glUtil::loadShader(char const *path, GLenum shaderType)
 	std::string shaderCode = sstr.str();
 	inputStream.close();
 
+	// Insert the shared declarations and the defines. #line keeps the line
+	// numbers of compile errors matching the shader file.
+	std::stringstream prelude;
+	std::ifstream preludeStream(SHADER_PRELUDE_PATH, std::ios::in);
+	if (!preludeStream.is_open())
+	{
+		SPDLOG_ERROR("Cannot open shader file \"{0}\"", SHADER_PRELUDE_PATH);
+	}
+	else
+	{
+		prelude << preludeStream.rdbuf();
+	}
+	size_t versionEnd = shaderCode.find('\n');
+	if (versionEnd != std::string::npos)
+	{
+		shaderCode.insert(versionEnd + 1, prelude.str() + defines + "#line 2\n");
+	}
+
 	// Compile shader
 	SPDLOG_DEBUG("Compiling shader \"{0}\"", path);
 	char const *pShaderCode = shaderCode.c_str();
@@ -59,11 +80,20 @@ GLuint glUtil::loadShader(char const *path, GLenum shaderType)
 }
 
 GLuint glUtil::linkShaders(GLuint vertexShader, GLuint fragmentShader)
+{
+	return linkShaders(vertexShader, 0, fragmentShader);
+}
+
+GLuint glUtil::linkShaders(GLuint vertexShader, GLuint geometryShader, GLuint fragmentShader)
 {
 	// Link the program
-	SPDLOG_TRACE("Linking shader program. vertexShader={}, fragmentShader={}", vertexShader, fragmentShader);
+	SPDLOG_TRACE("Linking shader program. vertexShader={}, geometryShader={}, fragmentShader={}", vertexShader, geometryShader, fragmentShader);
 	GLuint program = glCreateProgram();
 	glAttachShader(program, vertexShader);
+	if (geometryShader != 0)
+	{
+		glAttachShader(program, geometryShader);
+	}
 	glAttachShader(program, fragmentShader);
 	glLinkProgram(program);
 
@@ -88,47 +118,16 @@ GLuint glUtil::linkShaders(GLuint vertexShader, GLuint fragmentShader)
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
 
-	return program;
-}
-
-GLuint glUtil::createTexture(std::string texturePath)
-{
-	// Read texture file
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(texturePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-
-	if (pixels == nullptr)
+	if (geometryShader != 0)
 	{
-		SPDLOG_ERROR("Cannot open texture file \"{0}\"", texturePath);
-		return 0;
+		glDetachShader(program, geometryShader);
+		glDeleteShader(geometryShader);
 	}
 
-	// Generate texture object
-	GLuint texture = 0;
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-
-	// Set the texture data
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texWidth, texHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-	
-	// Generate mipmap
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	// Set wrapping
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	// Set filtering method
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// Unbind texture
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	return texture;
+	return program;
 }
 
-GLuint glUtil::createCubeMapDepth(GLsizei size)
+GLuint glUtil::createCubeMapDepth(GLsizei size, GLenum internalFormat)
 {
 	// Generate and bind a new cube map texture
 	GLuint textureID;
@@ -136,12 +135,12 @@ GLuint glUtil::createCubeMapDepth(GLsizei size)
 	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
 	// Create empty 2D image for every face
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, internalFormat, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, internalFormat, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, internalFormat, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, internalFormat, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, internalFormat, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, internalFormat, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 
 	// Set texture parameters
 	glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -162,6 +161,85 @@ GLuint glUtil::createCubeMapDepth(GLsizei size)
 	return textureID;
 }
 
+GLuint glUtil::createCubeMapMoments(GLsizei size)
+{
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+	// Allocate all mipmap levels of every face
+	GLint levels = 0;
+	for (GLsizei levelSize = size; levelSize > 0; levelSize /= 2)
+	{
+		for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
+		{
+			glTexImage2D(face, levels, GL_RGBA32F, levelSize, levelSize, 0, GL_RGBA, GL_FLOAT, nullptr);
+		}
+		levels++;
+	}
+
+	// Set texture parameters. Filtering the moments filters the shadow.
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	return textureID;
+}
+
+GLuint glUtil::createTextureDepth(GLsizei size)
+{
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+
+	// Set texture parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	// Set comparison mode
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return textureID;
+}
+
+GLuint glUtil::createTextureArrayDepth(GLsizei size, GLsizei layers)
+{
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, size, size, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+
+	// Set texture parameters
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+
+	// Set comparison mode
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	return textureID;
+}
+
 void glUtil::createFramebufferDepth(GLsizei width, GLsizei height, GLuint& framebuffer, GLuint &depthBuffer)
 {
 	// Create and bind a framebuffer
@@ -191,28 +269,329 @@ void glUtil::createFramebufferDepth(GLsizei width, GLsizei height, GLuint& frame
 	}
 }
 
-glUtil::ShadowMap::~ShadowMap()
+void glUtil::setUniform(GLint location, bool value)
 {
-	if (m_framebuffer != 0)
+	glUniform1i(location, value);
+}
+
+void glUtil::setUniform(GLint location, int value)
+{
+	glUniform1i(location, value);
+}
+
+void glUtil::setUniform(GLint location, float value)
+{
+	glUniform1f(location, value);
+}
+
+void glUtil::setUniform(GLint location, glm::vec2 const& value)
+{
+	glUniform2fv(location, 1, glm::value_ptr(value));
+}
+
+void glUtil::setUniform(GLint location, glm::vec3 const& value)
+{
+	glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void glUtil::setUniform(GLint location, glm::vec4 const& value)
+{
+	glUniform4fv(location, 1, glm::value_ptr(value));
+}
+
+void glUtil::setUniform(GLint location, glm::mat4 const& value)
+{
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void glUtil::setUniform(GLint location, std::array<glm::mat4, 6> const& value)
+{
+	glUniformMatrix4fv(location, static_cast<GLsizei>(value.size()), GL_FALSE, glm::value_ptr(value[0]));
+}
+
+glUtil::ShaderProgram::ShaderProgram()
+	: m_program(0)
+	, m_uniformLocations()
+{
+}
+
+glUtil::ShaderProgram::ShaderProgram(ShaderProgram&& other)
+	: m_program(other.m_program)
+	, m_uniformLocations(std::move(other.m_uniformLocations))
+{
+	other.m_program = 0;
+}
+
+glUtil::ShaderProgram::~ShaderProgram()
+{
+	if (m_program != 0)
 	{
-		glDeleteFramebuffers(1, &m_framebuffer);
+		glDeleteProgram(m_program);
 	}
+}
 
-	if (m_depthBuffer != 0)
+void glUtil::ShaderProgram::init(char const* vertexShaderPath, char const* fragmentShaderPath)
+{
+	GLuint vertexShader = loadShader(vertexShaderPath, GL_VERTEX_SHADER);
+	GLuint fragmentShader = loadShader(fragmentShaderPath, GL_FRAGMENT_SHADER);
+	m_program = linkShaders(vertexShader, fragmentShader);
+
+	reflect();
+}
+
+void glUtil::ShaderProgram::initVariant(char const* vertexShaderPath, char const* fragmentShaderPath, std::string const& defines)
+{
+	if (m_program != 0)
 	{
-		glDeleteRenderbuffers(1, &m_depthBuffer);
+		glDeleteProgram(m_program);
 	}
 
-	if (m_cubeMap != 0)
+	GLuint vertexShader = loadShader(vertexShaderPath, GL_VERTEX_SHADER, defines);
+	GLuint fragmentShader = loadShader(fragmentShaderPath, GL_FRAGMENT_SHADER, defines);
+	m_program = linkShaders(vertexShader, fragmentShader);
+
+	reflect();
+}
+
+void glUtil::ShaderProgram::init(char const* vertexShaderPath, char const* geometryShaderPath, char const* fragmentShaderPath)
+{
+	GLuint vertexShader = loadShader(vertexShaderPath, GL_VERTEX_SHADER);
+	GLuint geometryShader = loadShader(geometryShaderPath, GL_GEOMETRY_SHADER);
+	GLuint fragmentShader = loadShader(fragmentShaderPath, GL_FRAGMENT_SHADER);
+	m_program = linkShaders(vertexShader, geometryShader, fragmentShader);
+
+	reflect();
+}
+
+void glUtil::ShaderProgram::use() const
+{
+	glUseProgram(m_program);
+}
+
+GLint glUtil::ShaderProgram::getUniformLocation(std::string const& name) const
+{
+	auto it = m_uniformLocations.find(name);
+	if (it == m_uniformLocations.end())
 	{
-		glDeleteTextures(1, &m_cubeMap);
+		SPDLOG_TRACE("Uniform \"{}\" is not active in program {}", name, m_program);
+		return -1;
 	}
+
+	return it->second;
+}
+
+void glUtil::ShaderProgram::setUniformBlockBinding(char const* blockName, GLuint binding) const
+{
+	GLuint blockIndex = glGetUniformBlockIndex(m_program, blockName);
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		SPDLOG_TRACE("Uniform block \"{}\" is not active in program {}", blockName, m_program);
+		return;
+	}
+
+	glUniformBlockBinding(m_program, blockIndex, binding);
+}
+
+void glUtil::ShaderProgram::reflect()
+{
+	m_uniformLocations.clear();
+
+	GLint nameLength = 0;
+	GLint size = 0;
+	GLenum type = 0;
+
+	// Uniforms. Members of uniform blocks have no location and are skipped.
+	GLint numUniforms = 0;
+	GLint maxUniformNameLength = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &numUniforms);
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxUniformNameLength);
+	std::vector<char> uniformName(maxUniformNameLength + 1);
+	for (GLint i = 0; i < numUniforms; ++i)
+	{
+		glGetActiveUniform(m_program, i, maxUniformNameLength, &nameLength, &size, &type, &uniformName[0]);
+		std::string name(&uniformName[0], nameLength);
+
+		GLint location = glGetUniformLocation(m_program, name.c_str());
+		if (location == -1)
+		{
+			continue;
+		}
+
+		// Arrays are reported as "name[0]" and can also be accessed by "name"
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+		{
+			m_uniformLocations[name.substr(0, name.size() - 3)] = location;
+		}
+		m_uniformLocations[name] = location;
+	}
+
+	SPDLOG_DEBUG("Program {} has {} active uniforms", m_program, m_uniformLocations.size());
+}
+
+glUtil::StateCache::StateCache()
+	: m_issuedCalls(0)
+	, m_elidedCalls(0)
+{
+	invalidate();
+}
+
+void glUtil::StateCache::invalidate()
+{
+	m_program = UNKNOWN;
+	m_vertexArray = UNKNOWN;
+	m_activeTextureUnit = UNKNOWN;
+	m_textureTargets.fill(UNKNOWN);
+	m_textures.fill(UNKNOWN);
+	m_framebuffer = UNKNOWN;
+	m_cullFace = UNKNOWN;
+	m_polygonOffsetEnabled = UNKNOWN;
+	m_polygonOffsetKnown = false;
+	m_polygonOffsetFactor = 0.f;
+	m_polygonOffsetUnits = 0.f;
+}
+
+template <typename T>
+bool glUtil::StateCache::isUnchanged(T& current, T value)
+{
+	if (current == value)
+	{
+		m_elidedCalls++;
+		return true;
+	}
+
+	current = value;
+	m_issuedCalls++;
+	return false;
+}
+
+void glUtil::StateCache::useProgram(GLuint program)
+{
+	if (!isUnchanged(m_program, program))
+	{
+		glUseProgram(program);
+	}
+}
+
+void glUtil::StateCache::bindVertexArray(GLuint vertexArray)
+{
+	if (!isUnchanged(m_vertexArray, vertexArray))
+	{
+		glBindVertexArray(vertexArray);
+	}
+}
+
+void glUtil::StateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	// Only the last target bound on a unit is tracked
+	if (m_textureTargets[unit] == target && m_textures[unit] == texture)
+	{
+		m_elidedCalls++;
+		return;
+	}
+
+	if (!isUnchanged(m_activeTextureUnit, unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+
+	m_textureTargets[unit] = target;
+	m_textures[unit] = texture;
+	m_issuedCalls++;
+	glBindTexture(target, texture);
+}
+
+void glUtil::StateCache::setActiveTexture(GLuint unit)
+{
+	if (!isUnchanged(m_activeTextureUnit, unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+}
+
+void glUtil::StateCache::bindFramebuffer(GLuint framebuffer)
+{
+	if (!isUnchanged(m_framebuffer, framebuffer))
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+}
+
+void glUtil::StateCache::setCullFace(GLenum mode)
+{
+	if (!isUnchanged(m_cullFace, mode))
+	{
+		glCullFace(mode);
+	}
+}
+
+void glUtil::StateCache::enablePolygonOffset(GLfloat factor, GLfloat units)
+{
+	if (!isUnchanged(m_polygonOffsetEnabled, static_cast<GLuint>(GL_TRUE)))
+	{
+		glEnable(GL_POLYGON_OFFSET_FILL);
+	}
+
+	if (m_polygonOffsetKnown && m_polygonOffsetFactor == factor && m_polygonOffsetUnits == units)
+	{
+		m_elidedCalls++;
+		return;
+	}
+
+	m_polygonOffsetKnown = true;
+	m_polygonOffsetFactor = factor;
+	m_polygonOffsetUnits = units;
+	m_issuedCalls++;
+	glPolygonOffset(factor, units);
+}
+
+void glUtil::StateCache::disablePolygonOffset()
+{
+	if (!isUnchanged(m_polygonOffsetEnabled, static_cast<GLuint>(GL_FALSE)))
+	{
+		glDisable(GL_POLYGON_OFFSET_FILL);
+	}
+}
+
+void glUtil::StateCache::resetCounters()
+{
+	m_issuedCalls = 0;
+	m_elidedCalls = 0;
+}
+
+glUtil::ShadowMap::ShadowMap()
+	: m_framebuffer(0)
+	, m_depthBuffer(0)
+	, m_cubeMap(0)
+	, m_size(0)
+	, m_staticCubeMap(0)
+	, m_copyFramebuffer(0)
+	, m_paraboloidMap(0)
+	, m_tetrahedralMap(0)
+	, m_depthFormat(GL_DEPTH_COMPONENT)
+	, m_momentMap(0)
+	, m_momentFramebuffer(0)
+	, m_momentDepthBuffer(0)
+	, m_dirtyFaces(0x3F)
+{
+}
+
+glUtil::ShadowMap::~ShadowMap()
+{
+	release();
 }
 
 void glUtil::ShadowMap::init(GLsizei size)
 {
 	m_size = size;
-	m_cubeMap = createCubeMapDepth(size);
+	m_cubeMap = createCubeMapDepth(size, m_depthFormat);
+	m_staticCubeMap = 0;
+	m_copyFramebuffer = 0;
+	m_paraboloidMap = 0;
+	m_tetrahedralMap = 0;
+	m_momentMap = 0;
+	m_momentFramebuffer = 0;
+	m_momentDepthBuffer = 0;
+	m_dirtyFaces = 0x3F;
 	createFramebufferDepth(size, size, m_framebuffer, m_depthBuffer);
 }
 
@@ -223,24 +602,33 @@ void glUtil::ShadowMap::recreate(GLsizei size)
 		return;
 	}
 
-	if (m_framebuffer != 0)
+	release();
+	init(size);
+}
+
+void glUtil::ShadowMap::setDepthFormat(GLenum depthFormat)
+{
+	if (m_depthFormat == depthFormat)
 	{
-		glDeleteFramebuffers(1, &m_framebuffer);
+		return;
 	}
-
-	if (m_depthBuffer != 0)
+	m_depthFormat = depthFormat;
+	if (m_cubeMap == 0)
 	{
-		glDeleteRenderbuffers(1, &m_depthBuffer);
+		return;
 	}
 
-	if (m_cubeMap != 0)
+	// The static cube map is recreated on its next use
+	glDeleteTextures(1, &m_cubeMap);
+	m_cubeMap = createCubeMapDepth(m_size, m_depthFormat);
+	if (m_staticCubeMap != 0)
 	{
-		glDeleteTextures(1, &m_cubeMap);
+		glDeleteTextures(1, &m_staticCubeMap);
+		m_staticCubeMap = 0;
+		glDeleteFramebuffers(1, &m_copyFramebuffer);
+		m_copyFramebuffer = 0;
 	}
-
-	m_size = size;
-	m_cubeMap = createCubeMapDepth(size);
-	createFramebufferDepth(size, size, m_framebuffer, m_depthBuffer);
+	m_dirtyFaces = 0x3F;
 }
 
 void glUtil::ShadowMap::setCubeMapFace(GLenum face) const
@@ -248,6 +636,132 @@ void glUtil::ShadowMap::setCubeMapFace(GLenum face) const
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, face, m_cubeMap, 0);
 }
 
+void glUtil::ShadowMap::setCubeMapLayered() const
+{
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_cubeMap, 0);
+}
+
+void glUtil::ShadowMap::setStaticCubeMapFace(GLenum face)
+{
+	createStaticCubeMap();
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, face, m_staticCubeMap, 0);
+}
+
+void glUtil::ShadowMap::setStaticCubeMapLayered()
+{
+	createStaticCubeMap();
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_staticCubeMap, 0);
+}
+
+void glUtil::ShadowMap::copyStaticCubeMapFace(GLenum face) const
+{
+	// Copy the depth of the static face into the face attached to m_framebuffer
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_copyFramebuffer);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, face, m_staticCubeMap, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+	glBlitFramebuffer(0, 0, m_size, m_size, 0, 0, m_size, m_size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	// Restore the framebuffer binding
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+}
+
+void glUtil::ShadowMap::setParaboloidLayer(GLint layer)
+{
+	if (m_paraboloidMap == 0)
+	{
+		m_paraboloidMap = createTextureArrayDepth(m_size, 2);
+	}
+
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_paraboloidMap, 0, layer);
+}
+
+void glUtil::ShadowMap::setTetrahedralMap()
+{
+	if (m_tetrahedralMap == 0)
+	{
+		m_tetrahedralMap = createTextureDepth(m_size);
+	}
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_tetrahedralMap, 0);
+}
+
+void glUtil::ShadowMap::createMomentCubeMap()
+{
+	if (m_momentMap != 0)
+	{
+		return;
+	}
+
+	GLsizei size = getMomentMapSize();
+	m_momentMap = createCubeMapMoments(size);
+
+	// The framebuffer renders into the color attachment with its own depth buffer
+	createFramebufferDepth(size, size, m_momentFramebuffer, m_momentDepthBuffer);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void glUtil::ShadowMap::setMomentCubeMapFace(GLenum face) const
+{
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, face, m_momentMap, 0);
+}
+
+void glUtil::ShadowMap::generateMomentMipmaps() const
+{
+	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+}
+
+GLsizei glUtil::ShadowMap::getMomentMapSize() const
+{
+	return std::max(m_size / 4, 1);
+}
+
+void glUtil::ShadowMap::releaseMomentCubeMap()
+{
+	if (m_momentMap != 0)
+	{
+		glDeleteTextures(1, &m_momentMap);
+		m_momentMap = 0;
+	}
+
+	if (m_momentFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_momentFramebuffer);
+		m_momentFramebuffer = 0;
+	}
+
+	if (m_momentDepthBuffer != 0)
+	{
+		glDeleteRenderbuffers(1, &m_momentDepthBuffer);
+		m_momentDepthBuffer = 0;
+	}
+}
+
+void glUtil::ShadowMap::markFaceDirty(GLenum face)
+{
+	m_dirtyFaces = static_cast<uint8_t>(m_dirtyFaces | (1u << (face - GL_TEXTURE_CUBE_MAP_POSITIVE_X)));
+}
+
+void glUtil::ShadowMap::markAllFacesDirty()
+{
+	m_dirtyFaces = 0x3F;
+}
+
+void glUtil::ShadowMap::clearFaceDirty(GLenum face)
+{
+	m_dirtyFaces = static_cast<uint8_t>(m_dirtyFaces & ~(1u << (face - GL_TEXTURE_CUBE_MAP_POSITIVE_X)));
+}
+
+bool glUtil::ShadowMap::isFaceDirty(GLenum face) const
+{
+	return (m_dirtyFaces & (1 << (face - GL_TEXTURE_CUBE_MAP_POSITIVE_X))) != 0;
+}
+
+bool glUtil::ShadowMap::hasDirtyFaces() const
+{
+	return m_dirtyFaces != 0;
+}
+
 glm::mat4 glUtil::ShadowMap::getViewMatrix(GLenum face, glm::vec3 position) const
 {
 	glm::vec3 viewDirection = getViewDir(face);
@@ -263,6 +777,29 @@ glm::mat4 glUtil::ShadowMap::getProjectionMatrix(float near, float far) const
 	return glm::perspective(glm::radians(90.0f), 1.0f, near, far);
 }
 
+glm::mat4 glUtil::ShadowMap::getTetrahedronViewMatrix(int face, glm::vec3 position) const
+{
+	// Directions to the vertices of a regular tetrahedron
+	glm::vec3 const directions[4] = {
+		glm::vec3( 1.f,  1.f,  1.f),
+		glm::vec3( 1.f, -1.f, -1.f),
+		glm::vec3(-1.f,  1.f, -1.f),
+		glm::vec3(-1.f, -1.f,  1.f),
+	};
+
+	glm::vec3 viewDirection = glm::normalize(directions[face]);
+
+	return glm::lookAt(position, position + viewDirection, glm::vec3(0.f, 1.f, 0.f));
+}
+
+glm::mat4 glUtil::ShadowMap::getTetrahedronProjectionMatrix(float near, float far) const
+{
+	// The directions closest to a face are at most acos(1/3) (about 70.5 
+	// degrees) away from it. A half angle of atan(3) leaves a small margin for
+	// filtering at the tile borders.
+	return glm::frustum(-3.f * near, 3.f * near, -3.f * near, 3.f * near, near, far);
+}
+
 glm::vec3 glUtil::ShadowMap::getViewDir(GLenum face) const
 {
 	switch (face)
@@ -312,3 +849,66 @@ glm::vec3 glUtil::ShadowMap::getUpDir(GLenum face) const
 		return glm::vec3(0, 1, 0);
 	}
 }
+
+void glUtil::ShadowMap::createStaticCubeMap()
+{
+	if (m_staticCubeMap != 0)
+	{
+		return;
+	}
+
+	m_staticCubeMap = createCubeMapDepth(m_size, m_depthFormat);
+
+	// Create the framebuffer used as copy source
+	glGenFramebuffers(1, &m_copyFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_copyFramebuffer);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+}
+
+void glUtil::ShadowMap::release()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+
+	if (m_depthBuffer != 0)
+	{
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		m_depthBuffer = 0;
+	}
+
+	if (m_cubeMap != 0)
+	{
+		glDeleteTextures(1, &m_cubeMap);
+		m_cubeMap = 0;
+	}
+
+	if (m_staticCubeMap != 0)
+	{
+		glDeleteTextures(1, &m_staticCubeMap);
+		m_staticCubeMap = 0;
+	}
+
+	if (m_copyFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_copyFramebuffer);
+		m_copyFramebuffer = 0;
+	}
+
+	if (m_paraboloidMap != 0)
+	{
+		glDeleteTextures(1, &m_paraboloidMap);
+		m_paraboloidMap = 0;
+	}
+
+	if (m_tetrahedralMap != 0)
+	{
+		glDeleteTextures(1, &m_tetrahedralMap);
+		m_tetrahedralMap = 0;
+	}
+
+	releaseMomentCubeMap();
+}
@@ -2,40 +2,317 @@
 
 #include <GL/glew.h>
 
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
 
+#include <array>
 #include <string>
+#include <cstdint>
+#include <unordered_map>
 
 
 namespace glUtil
 {
-	GLuint loadShader(char const *path, GLenum shaderType);
+	// Compiles the shader with the shared declarations of frameBlock.glsl
+	// and the defines, e.g. "#define NAME 1\n", inserted after its #version
+	// line
+	GLuint loadShader(char const *path, GLenum shaderType, std::string const& defines = "");
 	GLuint linkShaders(GLuint vertexShader, GLuint fragmentShader);
+	GLuint linkShaders(GLuint vertexShader, GLuint geometryShader, GLuint fragmentShader);
 
-	GLuint createTexture(std::string texturePath);
-	GLuint createCubeMapDepth(GLsizei size);
+	GLuint createCubeMapDepth(GLsizei size, GLenum internalFormat);
+	GLuint createCubeMapMoments(GLsizei size);
+	GLuint createTextureDepth(GLsizei size);
+	GLuint createTextureArrayDepth(GLsizei size, GLsizei layers);
 	void createFramebufferDepth(GLsizei width, GLsizei height, GLuint& framebuffer, GLuint& depthBuffer);
 
+	// Binding points of the uniform blocks used by the shaders
+	enum UniformBlockBinding : GLuint
+	{
+		FRAME_BLOCK_BINDING = 0,
+		POINT_LIGHT_BLOCK_BINDING = 1,
+	};
+
+	// Per instance vertex attribute which holds the indices into the transform
+	// and material buffers and the offset of the baked visibility. The 
+	// renderer points it at the instance data of each draw.
+	GLuint const DRAW_ID_ATTRIBUTE = 3;
+
+	// Instance data read through DRAW_ID_ATTRIBUTE
+	struct DrawInstance
+	{
+		uint32_t transformIndex;
+		uint32_t materialIndex;
+		uint32_t bakedOffset; // first texel of the baked visibility minus the base vertex, ~0u without
+	};
+
+	// Texture units of the transform and material buffers
+	GLint const TRANSFORM_TEXTURE_UNIT = 4;
+	GLint const MATERIAL_TEXTURE_UNIT = 5;
+
+	// Texture units of the dual paraboloid and tetrahedral shadow maps. The 
+	// cube shadow map uses unit 0.
+	GLint const PARABOLOID_SHADOW_TEXTURE_UNIT = 6;
+	GLint const TETRAHEDRAL_SHADOW_TEXTURE_UNIT = 7;
+
+	// Texture units of the cube map arrays holding the point light shadow 
+	// maps, one consecutive unit per resolution tier
+	GLint const POINT_SHADOW_TEXTURE_UNIT = 8;
+	GLint const POINT_SHADOW_TIER_COUNT = 4;
+
+	// Texture unit of the prefiltered moment cube map
+	GLint const MOMENT_SHADOW_TEXTURE_UNIT = 12;
+
+	// Texture unit of the baked point light visibility of the static meshes
+	GLint const BAKED_VISIBILITY_TEXTURE_UNIT = 13;
+
+	// Sets the uniform at the location of the currently used program
+	void setUniform(GLint location, bool value);
+	void setUniform(GLint location, int value);
+	void setUniform(GLint location, float value);
+	void setUniform(GLint location, glm::vec2 const& value);
+	void setUniform(GLint location, glm::vec3 const& value);
+	void setUniform(GLint location, glm::vec4 const& value);
+	void setUniform(GLint location, glm::mat4 const& value);
+	void setUniform(GLint location, std::array<glm::mat4, 6> const& value);
+
+	// Typed handle of a uniform whose location was resolved at link time.
+	// Setting a uniform which is not active in the program has no effect.
+	template <typename T>
+	class Uniform
+	{
+	public:
+		Uniform()
+			: m_location(-1)
+		{
+		}
+
+		explicit Uniform(GLint location)
+			: m_location(location)
+		{
+		}
+
+		// Sets the value in the currently used program
+		void set(T const& value) const
+		{
+			setUniform(m_location, value);
+		}
+
+		bool isActive() const
+		{
+			return m_location != -1;
+		}
+
+		GLint m_location;
+	};
+
+	// Linked shader program with the locations of all active uniforms, which
+	// are queried once after linking. Attributes use fixed locations.
+	class ShaderProgram
+	{
+	public:
+		ShaderProgram();
+		~ShaderProgram();
+
+		// Takes over the program of the other object
+		ShaderProgram(ShaderProgram&& other);
+
+		// Delete copy constructor and assignment operators, a copy would 
+		// delete the program twice
+		ShaderProgram(ShaderProgram const&) = delete;
+		ShaderProgram& operator=(ShaderProgram const&) = delete;
+		ShaderProgram& operator=(ShaderProgram&& other) = delete;
+
+		// Loads, compiles and links the shaders
+		void init(char const* vertexShaderPath, char const* fragmentShaderPath);
+		void init(char const* vertexShaderPath, char const* geometryShaderPath, char const* fragmentShaderPath);
+
+		// Same as init() with the defines inserted into both shaders. 
+		// Replaces the program of an earlier call.
+		void initVariant(char const* vertexShaderPath, char const* fragmentShaderPath, std::string const& defines);
+
+		void use() const;
+
+		// Returns -1 if the uniform is not active
+		GLint getUniformLocation(std::string const& name) const;
+
+		template <typename T>
+		Uniform<T> getUniform(std::string const& name) const
+		{
+			return Uniform<T>(getUniformLocation(name));
+		}
+
+		// Assigns the uniform block to the binding point. Ignored if the 
+		// block is not active.
+		void setUniformBlockBinding(char const* blockName, GLuint binding) const;
+
+		GLuint m_program;
+
+	private:
+		void reflect();
+
+		std::unordered_map<std::string, GLint> m_uniformLocations;
+	};
+
+	// Shadows the bound program, vertex array, textures, framebuffer, cull 
+	// face and polygon offset and drops calls which would not change them. 
+	// Objects bound directly with GL calls are not tracked, call invalidate()
+	// afterwards. The uniform buffers are bound to their binding points once.
+	class StateCache
+	{
+	public:
+		StateCache();
+
+		// Forgets the tracked state. The next call of each kind is issued.
+		void invalidate();
+
+		void useProgram(GLuint program);
+		void bindVertexArray(GLuint vertexArray);
+		void bindTexture(GLuint unit, GLenum target, GLuint texture);
+		void setActiveTexture(GLuint unit);
+		void bindFramebuffer(GLuint framebuffer); // binds GL_FRAMEBUFFER
+		void setCullFace(GLenum mode);
+		void enablePolygonOffset(GLfloat factor, GLfloat units);
+		void disablePolygonOffset();
+
+		// Resets the counters of issued and elided calls
+		void resetCounters();
+
+		uint32_t m_issuedCalls; // GL calls passed on since the last reset
+		uint32_t m_elidedCalls; // GL calls dropped since the last reset
+
+	private:
+		// Returns true and counts the elided call if the state is unchanged.
+		// Otherwise stores the new value and counts the issued call.
+		template <typename T>
+		bool isUnchanged(T& current, T value);
+
+		static GLuint const UNKNOWN = ~0u;
+		static size_t const MAX_TEXTURE_UNITS = 16;
+
+		GLuint m_program;
+		GLuint m_vertexArray;
+		GLuint m_activeTextureUnit;
+		std::array<GLenum, MAX_TEXTURE_UNITS> m_textureTargets;
+		std::array<GLuint, MAX_TEXTURE_UNITS> m_textures;
+		GLuint m_framebuffer;
+		GLenum m_cullFace;
+		GLuint m_polygonOffsetEnabled; // UNKNOWN, GL_TRUE or GL_FALSE
+		bool m_polygonOffsetKnown; // false until the parameters are set after invalidate()
+		GLfloat m_polygonOffsetFactor;
+		GLfloat m_polygonOffsetUnits;
+	};
+
 	class ShadowMap
 	{
 	public:
+		ShadowMap();
 		~ShadowMap();
 
 		void init(GLsizei size);
 		void recreate(GLsizei size);
 
+		// Deletes all maps and framebuffers. init() creates them again.
+		void release();
+
+		// Recreates the cube maps with the given depth format, e.g. 
+		// GL_DEPTH_COMPONENT16. All faces are dirty afterwards. A released
+		// map only keeps the format for the next init().
+		void setDepthFormat(GLenum depthFormat);
+
 		// Attaches the specified face of the cube map to the current framebuffer
 		void setCubeMapFace(GLenum face) const;
 
+		// Attaches all faces of the cube map as layers to the current 
+		// framebuffer. Layer i is face GL_TEXTURE_CUBE_MAP_POSITIVE_X + i.
+		void setCubeMapLayered() const;
+
+		// Attaches the specified face of the static cube map to the current 
+		// framebuffer. The static cube map is created on first use.
+		void setStaticCubeMapFace(GLenum face);
+
+		// Same as setCubeMapLayered() for the static cube map
+		void setStaticCubeMapLayered();
+
+		// Attaches one hemisphere of the dual paraboloid map to the current 
+		// framebuffer. Layer 0 faces +z, layer 1 faces -z. The map is created
+		// on first use.
+		void setParaboloidLayer(GLint layer);
+
+		// Attaches the tetrahedral map to the current framebuffer. The map is
+		// created on first use.
+		void setTetrahedralMap();
+
+		// Creates the moment cube map of the variance shadow filters and its
+		// framebuffer if necessary. The map has a quarter of the size of the
+		// cube map and a full mipmap chain.
+		void createMomentCubeMap();
+
+		// Attaches the specified face of the moment cube map to the current
+		// framebuffer, which must be m_momentFramebuffer
+		void setMomentCubeMapFace(GLenum face) const;
+
+		// Prefilters the moments after all faces have been rendered. The 
+		// moment map must be bound to the active texture unit.
+		void generateMomentMipmaps() const;
+
+		GLsizei getMomentMapSize() const;
+
+		// Deletes the moment cube map and its framebuffer. They are created
+		// again on the next use.
+		void releaseMomentCubeMap();
+
+		// Copies the specified face of the static cube map into the face of
+		// the cube map which is currently attached to the shadow framebuffer
+		void copyStaticCubeMapFace(GLenum face) const;
+
+		// Dirty faces contain outdated depth and need to be re-rendered. All 
+		// faces are dirty after (re)creation.
+		void markFaceDirty(GLenum face);
+		void markAllFacesDirty();
+		void clearFaceDirty(GLenum face);
+		bool isFaceDirty(GLenum face) const;
+		bool hasDirtyFaces() const;
+
 		glm::mat4 getViewMatrix(GLenum face, glm::vec3 position) const;
 		glm::mat4 getProjectionMatrix(float near, float far) const;
 
+		// Frusta of the four tetrahedron faces. Each frustum contains the cone
+		// around its face direction and is rendered into one tile of the 
+		// tetrahedral map, tile i covering the quarter (i % 2, i / 2).
+		glm::mat4 getTetrahedronViewMatrix(int face, glm::vec3 position) const;
+		glm::mat4 getTetrahedronProjectionMatrix(float near, float far) const;
+
 		GLuint m_framebuffer;
 		GLuint m_depthBuffer;
 		GLuint m_cubeMap;
 		GLsizei m_size;
 
+		// Cube map which only contains static shadow casters. Copied into the
+		// cube map before dynamic casters are rendered.
+		GLuint m_staticCubeMap;
+		GLuint m_copyFramebuffer; // read framebuffer used for copying
+
+		// Alternative parameterizations, see ShadowMapType
+		GLuint m_paraboloidMap; // 2D array with one layer per hemisphere
+		GLuint m_tetrahedralMap; // 2D map with 2x2 tiles
+
+		GLenum m_depthFormat; // internal format of the cube maps
+
+		// Moments of the light distance, see createMomentCubeMap()
+		GLuint m_momentMap;
+		GLuint m_momentFramebuffer;
+		GLuint m_momentDepthBuffer;
+
 	private:
+		// Creates the static cube map and the copy framebuffer if necessary
+		void createStaticCubeMap();
+
+		// Bit i is set if face GL_TEXTURE_CUBE_MAP_POSITIVE_X + i is dirty
+		uint8_t m_dirtyFaces;
+
 		glm::vec3 getViewDir(GLenum face) const;
 		glm::vec3 getUpDir(GLenum face) const;
 	};
@@ -0,0 +1,297 @@
+#include "lightBaker.hpp"
+
+#include "log.hpp"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <algorithm>
+
+
+// Distance the rays start off the surface along the normal to avoid self
+// intersection
+static float const RAY_OFFSET = 0.01f;
+
+// Returns true if the ray enters the box before the distance
+static bool intersectsRay(BoundingBox const& bounds, glm::vec3 origin, glm::vec3 inverseDirection, float distance)
+{
+	glm::vec3 t0 = (bounds.min - origin) * inverseDirection;
+	glm::vec3 t1 = (bounds.max - origin) * inverseDirection;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, distance));
+	return enter <= exit;
+}
+
+LightBaker::LightBaker()
+	: m_triangles()
+	, m_nodes()
+	, m_lights()
+	, m_staticVersion(0)
+	, m_firstVertices()
+	, m_visibility()
+{
+}
+
+void LightBaker::bake(SceneGraph const& scene, std::vector<LightSource> const& lights)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	buildHierarchy(scene);
+
+	m_lights.clear();
+	for (size_t i = 0; i < lights.size() && i < MAX_LIGHTS; ++i)
+	{
+		m_lights.push_back({ lights[i].position, lights[i].radius, lights[i].version });
+	}
+	m_staticVersion = scene.getStaticVersion();
+
+	// Every mesh of a static node gets its own vertices, since instances of
+	// the same mesh see the lights from different places
+	struct Receiver
+	{
+		Mesh const* mesh;
+		glm::mat4 modelMatrix;
+		uint32_t firstVertex;
+	};
+	std::vector<Receiver> receivers;
+	uint32_t vertexCount = 0;
+	m_firstVertices.clear();
+	for (SceneGraph::SceneNode const& node : scene.getNodes())
+	{
+		if (!node.isStatic)
+		{
+			continue;
+		}
+
+		for (size_t i = 0; i < node.meshes.size(); ++i)
+		{
+			uint64_t id = (static_cast<uint64_t>(node.index) << 32) | i;
+			m_firstVertices[id] = vertexCount;
+			receivers.push_back({ node.meshes[i], node.modelMatrix, vertexCount });
+			vertexCount += node.meshes[i]->numVertices;
+		}
+	}
+
+	m_visibility.assign(static_cast<size_t>(vertexCount) * TEXELS_PER_VERTEX * 4, 255);
+	for (Receiver const& receiver : receivers)
+	{
+		glm::mat3 normalMatrix = glm::inverse(glm::transpose(glm::mat3(receiver.modelMatrix)));
+		std::vector<Vertex> const& vertices = receiver.mesh->vertices;
+
+		#pragma omp parallel for schedule(dynamic, 64)
+		for (int i = 0; i < static_cast<int>(vertices.size()); ++i)
+		{
+			glm::vec3 position = glm::vec3(receiver.modelMatrix * glm::vec4(vertices[i].position, 1.f));
+			glm::vec3 normal = glm::normalize(normalMatrix * vertices[i].normal);
+			uint8_t* visibility = &m_visibility[(static_cast<size_t>(receiver.firstVertex) + i) * TEXELS_PER_VERTEX * 4];
+
+			for (size_t light = 0; light < m_lights.size(); ++light)
+			{
+				// Vertices outside of the radius are not lit anyway
+				glm::vec3 toLight = m_lights[light].position - position;
+				if (glm::dot(toLight, toLight) > m_lights[light].radius * m_lights[light].radius)
+				{
+					continue;
+				}
+
+				// Start on the side of the surface which faces the light
+				glm::vec3 origin = position + (glm::dot(normal, toLight) >= 0.f ? RAY_OFFSET : -RAY_OFFSET) * normal;
+				glm::vec3 direction = m_lights[light].position - origin;
+				float distance = glm::length(direction);
+				if (distance > 0.f && isOccluded(origin, direction / distance, distance))
+				{
+					visibility[light] = 0;
+				}
+			}
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	SPDLOG_INFO("Baked {} point lights into {} vertices against {} triangles in {:.0f} ms",
+		m_lights.size(), vertexCount, m_triangles.size(), std::chrono::duration<double, std::milli>(end - start).count());
+}
+
+bool LightBaker::isBaked(size_t index, LightSource const& light) const
+{
+	return
+		index < m_lights.size() &&
+		m_lights[index].version == light.version &&
+		m_lights[index].position == light.position &&
+		m_lights[index].radius == light.radius;
+}
+
+bool LightBaker::isEmpty() const
+{
+	return m_lights.empty();
+}
+
+uint64_t LightBaker::getStaticVersion() const
+{
+	return m_staticVersion;
+}
+
+uint32_t LightBaker::getFirstVertex(uint64_t instanceId) const
+{
+	auto it = m_firstVertices.find(instanceId);
+	return it != m_firstVertices.end() ? it->second : NO_VISIBILITY;
+}
+
+std::vector<uint8_t> const& LightBaker::getVisibility() const
+{
+	return m_visibility;
+}
+
+void LightBaker::buildHierarchy(SceneGraph const& scene)
+{
+	// World space triangles of the static casters
+	m_triangles.clear();
+	std::vector<glm::vec3> centroids;
+	std::vector<BoundingBox> bounds;
+	for (SceneGraph::SceneNode const& node : scene.getNodes())
+	{
+		if (!node.isStatic || !node.castsShadow)
+		{
+			continue;
+		}
+
+		for (Mesh const* mesh : node.meshes)
+		{
+			for (size_t i = 0; i + 2 < mesh->indices.size(); i += 3)
+			{
+				glm::vec3 v0 = glm::vec3(node.modelMatrix * glm::vec4(mesh->vertices[mesh->indices[i + 0]].position, 1.f));
+				glm::vec3 v1 = glm::vec3(node.modelMatrix * glm::vec4(mesh->vertices[mesh->indices[i + 1]].position, 1.f));
+				glm::vec3 v2 = glm::vec3(node.modelMatrix * glm::vec4(mesh->vertices[mesh->indices[i + 2]].position, 1.f));
+				m_triangles.push_back({ v0, v1 - v0, v2 - v0 });
+
+				BoundingBox triangleBounds;
+				triangleBounds.extend(v0);
+				triangleBounds.extend(v1);
+				triangleBounds.extend(v2);
+				bounds.push_back(triangleBounds);
+				centroids.push_back((v0 + v1 + v2) / 3.f);
+			}
+		}
+	}
+
+	m_nodes.clear();
+	if (m_triangles.empty())
+	{
+		return;
+	}
+
+	std::vector<uint32_t> order(m_triangles.size());
+	for (uint32_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+	buildNode(order, centroids, bounds, 0, static_cast<uint32_t>(order.size()));
+
+	// Store the triangles in the order of the leaves
+	std::vector<Triangle> triangles;
+	triangles.reserve(m_triangles.size());
+	for (uint32_t index : order)
+	{
+		triangles.push_back(m_triangles[index]);
+	}
+	m_triangles.swap(triangles);
+}
+
+uint32_t LightBaker::buildNode(std::vector<uint32_t>& order, std::vector<glm::vec3> const& centroids, std::vector<BoundingBox> const& bounds, uint32_t first, uint32_t count)
+{
+	uint32_t index = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.push_back({ BoundingBox(), first, count });
+
+	BoundingBox nodeBounds;
+	BoundingBox centroidBounds;
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		nodeBounds.extend(bounds[order[i]]);
+		centroidBounds.extend(centroids[order[i]]);
+	}
+	m_nodes[index].bounds = nodeBounds;
+
+	if (count <= MAX_LEAF_TRIANGLES)
+	{
+		return index;
+	}
+
+	glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+	int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+	uint32_t half = count / 2;
+	std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+		[&centroids, axis](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+	// The first child directly follows this node
+	buildNode(order, centroids, bounds, first, half);
+	uint32_t second = buildNode(order, centroids, bounds, first + half, count - half);
+	m_nodes[index].first = second;
+	m_nodes[index].count = 0;
+
+	return index;
+}
+
+bool LightBaker::isOccluded(glm::vec3 origin, glm::vec3 direction, float distance) const
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	glm::vec3 inverseDirection = 1.f / direction;
+
+	uint32_t stack[64];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		Node const& node = m_nodes[stack[--stackSize]];
+		if (!intersectsRay(node.bounds, origin, inverseDirection, distance))
+		{
+			continue;
+		}
+
+		if (node.count == 0)
+		{
+			stack[stackSize++] = static_cast<uint32_t>(&node - m_nodes.data()) + 1;
+			stack[stackSize++] = node.first;
+			continue;
+		}
+
+		// Moeller-Trumbore intersection, any hit is enough
+		for (uint32_t i = node.first; i < node.first + node.count; ++i)
+		{
+			Triangle const& triangle = m_triangles[i];
+			glm::vec3 p = glm::cross(direction, triangle.edge2);
+			float determinant = glm::dot(triangle.edge1, p);
+			if (std::abs(determinant) < 1e-12f)
+			{
+				continue;
+			}
+
+			float inverseDeterminant = 1.f / determinant;
+			glm::vec3 s = origin - triangle.v0;
+			float u = glm::dot(s, p) * inverseDeterminant;
+			if (u < 0.f || u > 1.f)
+			{
+				continue;
+			}
+
+			glm::vec3 q = glm::cross(s, triangle.edge1);
+			float v = glm::dot(direction, q) * inverseDeterminant;
+			if (v < 0.f || u + v > 1.f)
+			{
+				continue;
+			}
+
+			float t = glm::dot(triangle.edge2, q) * inverseDeterminant;
+			if (t > 0.f && t < distance)
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "scene/sceneGraph.hpp"
+#include "scene/lightSource.hpp"
+#include "scene/boundingBox.hpp"
+
+#include <glm/vec3.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+
+// Bakes the visibility of fixed point lights into the vertices of the
+// static meshes. A ray from each vertex to each light is traced against a
+// bounding volume hierarchy of the static shadow casters.
+class LightBaker
+{
+public:
+	static uint32_t const MAX_LIGHTS = 32;
+
+	// The visibility of a vertex is stored in RGBA8 texels, one light per
+	// channel
+	static uint32_t const TEXELS_PER_VERTEX = MAX_LIGHTS / 4;
+
+	// Returned by getFirstVertex() for meshes without baked visibility
+	static uint32_t const NO_VISIBILITY = ~0u;
+
+	LightBaker();
+
+	// Traces the visibility of the first MAX_LIGHTS lights from all vertices
+	// of the static nodes of the scene. Only static casters occlude the lights.
+	void bake(SceneGraph const& scene, std::vector<LightSource> const& lights);
+
+	// Returns true if the visibility of the light with the index was baked
+	// at its current position and radius
+	bool isBaked(size_t index, LightSource const& light) const;
+
+	// Returns true if nothing has been baked yet
+	bool isEmpty() const;
+
+	// Static version of the scene the visibility was baked for
+	uint64_t getStaticVersion() const;
+
+	// Returns the index of the first vertex of the mesh instance in the
+	// visibility or NO_VISIBILITY. The id is the one of MeshInstance.
+	uint32_t getFirstVertex(uint64_t instanceId) const;
+
+	// RGBA8 texels, TEXELS_PER_VERTEX per vertex
+	std::vector<uint8_t> const& getVisibility() const;
+
+private:
+	// Triangle prepared for ray intersection
+	struct Triangle
+	{
+		glm::vec3 v0;
+		glm::vec3 edge1; // v1 - v0
+		glm::vec3 edge2; // v2 - v0
+	};
+
+	// Node of the hierarchy. The first child of an inner node directly
+	// follows it.
+	struct Node
+	{
+		BoundingBox bounds;
+		uint32_t first; // first triangle of a leaf, second child of an inner node
+		uint32_t count; // number of triangles of a leaf, 0 for inner nodes
+	};
+
+	// Position, radius and version of a light at the time it was baked
+	struct BakedLight
+	{
+		glm::vec3 position;
+		float radius;
+		uint64_t version;
+	};
+
+	// Collects the triangles of the static casters and builds the hierarchy
+	void buildHierarchy(SceneGraph const& scene);
+
+	// Splits the triangles at the median of the longest axis of their
+	// centroids until a node holds at most MAX_LEAF_TRIANGLES. Returns the
+	// index of the node.
+	uint32_t buildNode(std::vector<uint32_t>& order, std::vector<glm::vec3> const& centroids, std::vector<BoundingBox> const& bounds, uint32_t first, uint32_t count);
+
+	// Returns true if the ray hits a triangle before the distance
+	bool isOccluded(glm::vec3 origin, glm::vec3 direction, float distance) const;
+
+	static uint32_t const MAX_LEAF_TRIANGLES = 4;
+
+	std::vector<Triangle> m_triangles;
+	std::vector<Node> m_nodes;
+
+	std::vector<BakedLight> m_lights;
+	uint64_t m_staticVersion;
+	std::unordered_map<uint64_t, uint32_t> m_firstVertices;
+	std::vector<uint8_t> m_visibility;
+};
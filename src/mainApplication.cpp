@@ -30,6 +30,9 @@ MainApplication::MainApplication()
 	, m_vfov(glm::radians(30.f))
 	, m_timeSinceLastFpsMeassure(0.f)
 	, m_framesSinceLastFpsMeassure(0)
+	, m_torusNode(0)
+	, m_torusPosition(-4.5f, 1.2f, -0.28f)
+	, m_torusAngle(0.f)
 {
 }
 
@@ -135,18 +138,48 @@ void MainApplication::createScene()
 	// Light source
 	m_lightSphere = std::make_unique<LightSphere>(&m_sceneGraph, 0, glm::vec3(0.f, 1.5f, -0.28f), &m_input, &m_camera);
 
+	// Dim point lights along both arcades on the ground and the upper floor
+	for (float y : { 1.5f, 5.5f })
+	{
+		for (float z : { -3.45f, 3.17f })
+		{
+			for (float x = -9.f; x <= 9.f; x += 3.f)
+			{
+				glm::vec4 color = (y < 3.f) ? glm::vec4(0.35f, 0.25f, 0.15f, 1.f) : glm::vec4(0.15f, 0.2f, 0.35f, 1.f);
+				m_pointLights.emplace_back(glm::vec3(x, y, z), glm::vec4(0.f), color, color, 3.5f);
+			}
+		}
+	}
+
 	// CrytekSponza
 	if (true)
 	{
 		// Read the obj
 		std::vector<std::unique_ptr<Mesh>> meshes;
 		std::vector<std::unique_ptr<Material>> materials;
-		Mesh::readObj("assets/scenes/CrytekSponza", "sponzaNoCurtain.obj", meshes, materials);
+		Mesh::readObj("assets/scenes/CrytekSponza", "sponzaNoCurtain.obj", meshes, materials, m_sceneGraph.getTextureArrays());
 
 		// Add meshed and textures to the scene graph
 		m_sceneGraph.takeMaterials(materials);
 		auto sponza = m_sceneGraph.takeMeshes(meshes);
 		m_sceneGraph.addNodeMeshes(0, sponza);
+
+		// Spinning torus in the middle of the atrium. It is the only dynamic 
+		// caster, which the shadow map renders on top of its static casters.
+		Material* torusMaterial = m_sceneGraph.takeMaterial(std::make_unique<Material>(
+			glm::vec4(0.5f * glm::vec3(0.2f, 1.0f, 0.2f), 1.f),
+			glm::vec4(0.7f * glm::vec3(0.2f, 1.0f, 0.2f), 1.f),
+			glm::vec4(0.3f * glm::vec3(0.2f, 1.0f, 0.2f), 1.f),
+			10.f,
+			1.f
+		));
+
+		std::vector<Vertex> verts;
+		std::vector<uint32_t> inds;
+		createTorus(0.5f, 0.1f, 0.f, 40, 40, verts, inds);
+		Mesh* torusMesh = m_sceneGraph.takeMesh(std::make_unique<Mesh>(verts, inds, *torusMaterial));
+		m_torusNode = m_sceneGraph.addNode(0, true, glm::translate(m_torusPosition) * glm::rotate(glm::radians(90.f), glm::vec3(0, 0, 1)), false);
+		m_sceneGraph.addNodeMesh(m_torusNode, torusMesh);
 	}
 
 	// Simple scene using primitives
@@ -333,6 +366,16 @@ void MainApplication::update(float deltaTimeSeconds)
 	m_lightSphere->update(deltaTimeSeconds);
 	m_camera.update(deltaTimeSeconds);
 
+	// Spin the upright torus around the vertical axis
+	if (m_torusNode != 0)
+	{
+		m_torusAngle = glm::mod(m_torusAngle + 45.f * deltaTimeSeconds, 360.f);
+		m_sceneGraph.setNodeTransformation(m_torusNode, 
+			glm::translate(m_torusPosition) * 
+			glm::rotate(glm::radians(m_torusAngle), glm::vec3(0, 1, 0)) * 
+			glm::rotate(glm::radians(90.f), glm::vec3(0, 0, 1)));
+	}
+
 	// Update other members
 	m_sceneGraph.update();
 	m_renderer.update();
@@ -365,9 +408,14 @@ void MainApplication::update(float deltaTimeSeconds)
 	{
 		printControls();
 	}
+	if (m_input.isPushed(GLFW_KEY_F5))
+	{
+		// Baking takes a while, so it only happens on request
+		m_renderer.bakeLighting(m_sceneGraph, m_pointLights);
+	}
 }
 
-void MainApplication::render() const
+void MainApplication::render()
 {
 	if (m_windowIsIconified)
 	{
@@ -377,6 +425,7 @@ void MainApplication::render() const
 	m_renderer.render(
 		m_sceneGraph, 
 		m_lightSphere->m_lightSource, 
+		m_pointLights,
 		m_camera.getViewMatrix(), 
 		m_vfov, 
 		m_windowWidth, m_windowHeight, 
@@ -444,6 +493,7 @@ void MainApplication::printControls() const
 	SPDLOG_INFO("  Arrow Keys - move light source horizontally");
 	SPDLOG_INFO("  I, J, K, L - move light source horizontally");
 	SPDLOG_INFO("  U, O       - move light source vertically");
+	SPDLOG_INFO("  Z          - cycle shadow map type of the light (cube, dual paraboloid, tetrahedral)");
 	SPDLOG_INFO("  F, F11     - toggle fullscreen");
 	SPDLOG_INFO("  ESC        - exit fullscreen");
 	SPDLOG_INFO("  T          - toggle VSync");
@@ -457,7 +507,20 @@ void MainApplication::printControls() const
 	SPDLOG_DEBUG(" N          - toggle glPolygonOffset (shadow map bias)");
 	SPDLOG_DEBUG(" 1, 2       - adjust polygon offset: units (constant bias)");
 	SPDLOG_DEBUG(" 3, 4       - adjust polygon offset: factor (angle dependent bias)");
-	SPDLOG_DEBUG(" 5, 6       - adjust shadow map resolution");
+	SPDLOG_DEBUG(" 5, 6       - adjust shadow map resolution (disables adaptive resolution)");
+	SPDLOG_DEBUG(" E          - toggle adaptive shadow map resolution");
+	SPDLOG_DEBUG(" 9          - toggle 16 bit linear distance shadow map");
+	SPDLOG_DEBUG(" F2         - cycle cube shadow map filter (depth comparison, VSM, EVSM)");
+	SPDLOG_DEBUG(" F3         - toggle CPU rasterization of the cube shadow map");
+	SPDLOG_DEBUG(" F4         - toggle baked visibility of the point lights for static meshes");
+	SPDLOG_DEBUG(" F5         - bake the visibility of the point lights into the static meshes");
+	SPDLOG_DEBUG(" C          - toggle caching of static shadow casters");
+	SPDLOG_DEBUG(" R          - toggle culling of casters and faces without visible receiver");
+	SPDLOG_DEBUG(" Y          - toggle single pass layered shadow map rendering");
+	SPDLOG_DEBUG(" G          - toggle multi draw indirect submission");
+	SPDLOG_DEBUG(" Q          - toggle additional shadowed point lights");
+	SPDLOG_DEBUG(" 7, 8       - adjust point light shadow faces rendered per frame");
+	SPDLOG_DEBUG(" M          - print render statistics");
 }
 
 void MainApplication::callbackGlfwError(int errorCode, const char* errorDescription)
@@ -12,6 +12,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 
 
 class MainApplication
@@ -27,7 +28,7 @@ private:
 	void createScene();
 
 	void update(float deltaTimeSeconds);
-	void render() const;
+	void render();
 
 	void setFullscreen(bool fullscreen);
 	void meassueFPS(float deltaTimeSeconds);
@@ -73,6 +74,14 @@ private:
 	// Game objects
 	std::unique_ptr<LightSphere> m_lightSphere;
 
+	// Spinning torus, a dynamic shadow caster
+	size_t m_torusNode;
+	glm::vec3 m_torusPosition;
+	float m_torusAngle; // rotation around the y axis in degrees
+
+	// Additional point lights, only rendered if enabled in the renderer
+	std::vector<LightSource> m_pointLights;
+
 public:
 	// Callback functions for GLFW
 	static void callbackGlfwError(int errorCode, const char* errorDescription);
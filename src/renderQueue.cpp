@@ -0,0 +1,94 @@
+#include "renderQueue.hpp"
+
+#include <algorithm>
+#include <array>
+
+
+RenderQueue::RenderQueue()
+	: m_items()
+	, m_scratch()
+{
+}
+
+uint64_t RenderQueue::makeKey(
+	uint32_t pass, 
+	uint32_t program, 
+	uint32_t material, 
+	uint32_t vertexArray, 
+	float depth, 
+	float maxDepth
+)
+{
+	// Quantize the depth. Draws behind maxDepth share the last bucket.
+	uint64_t const maxQuantizedDepth = (1 << 20) - 1;
+	float normalizedDepth = maxDepth > 0.f ? std::clamp(depth / maxDepth, 0.f, 1.f) : 0.f;
+	uint64_t quantizedDepth = static_cast<uint64_t>(normalizedDepth * maxQuantizedDepth);
+
+	return
+		(static_cast<uint64_t>(pass        & 0xF)    << 60) |
+		(static_cast<uint64_t>(program     & 0xFF)   << 52) |
+		(static_cast<uint64_t>(material    & 0xFFFF) << 36) |
+		(static_cast<uint64_t>(vertexArray & 0xFFFF) << 20) |
+		quantizedDepth;
+}
+
+void RenderQueue::clear()
+{
+	m_items.clear();
+}
+
+void RenderQueue::push(uint64_t key, uint32_t index)
+{
+	m_items.push_back({ key, index });
+}
+
+void RenderQueue::sort()
+{
+	if (m_items.size() < 2)
+	{
+		return;
+	}
+
+	// Count the occurrences of each digit value for all eight digits at once
+	std::array<std::array<uint32_t, 256>, 8> histograms = {};
+	for (Item const& item : m_items)
+	{
+		for (unsigned digit = 0; digit < 8; ++digit)
+		{
+			histograms[digit][(item.key >> (8 * digit)) & 0xFF]++;
+		}
+	}
+
+	m_scratch.resize(m_items.size());
+	for (unsigned digit = 0; digit < 8; ++digit)
+	{
+		std::array<uint32_t, 256>& histogram = histograms[digit];
+
+		// All keys have the same digit, the pass would not change the order
+		uint32_t firstValue = (m_items[0].key >> (8 * digit)) & 0xFF;
+		if (histogram[firstValue] == m_items.size())
+		{
+			continue;
+		}
+
+		// Exclusive prefix sum yields the first output position of each value
+		uint32_t offset = 0;
+		for (uint32_t& count : histogram)
+		{
+			uint32_t valueCount = count;
+			count = offset;
+			offset += valueCount;
+		}
+
+		for (Item const& item : m_items)
+		{
+			m_scratch[histogram[(item.key >> (8 * digit)) & 0xFF]++] = item;
+		}
+		m_items.swap(m_scratch);
+	}
+}
+
+std::vector<RenderQueue::Item> const& RenderQueue::getItems() const
+{
+	return m_items;
+}
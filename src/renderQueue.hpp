@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+
+// Flat list of draws ordered by 64 bit sort keys. From the most to the least
+// significant bits a key contains the pass (4 bits), the program (8 bits),
+// the material (16 bits), the vertex array (16 bits) and the quantized depth
+// (20 bits). Sorting groups draws by state and orders each state bucket 
+// front to back.
+class RenderQueue
+{
+public:
+	// A draw identified by its index into a list owned by the caller
+	struct Item
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	RenderQueue();
+
+	// Packs the key. Ids are truncated to the width of their field, which
+	// only affects the ordering. The depth is quantized over [0, maxDepth].
+	static uint64_t makeKey(
+		uint32_t pass,
+		uint32_t program,
+		uint32_t material,
+		uint32_t vertexArray,
+		float depth,
+		float maxDepth
+	);
+
+	void clear();
+	void push(uint64_t key, uint32_t index);
+
+	// Stable LSD radix sort with 8 bit digits. Digits which are equal for all 
+	// keys are skipped.
+	void sort();
+
+	std::vector<Item> const& getItems() const;
+
+private:
+	std::vector<Item> m_items;
+	std::vector<Item> m_scratch; // ping-pong buffer of sort()
+};
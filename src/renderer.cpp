@@ -1,6 +1,7 @@
 #include "renderer.hpp"
 
 #include "log.hpp"
+#include "frustum.hpp"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
@@ -9,26 +10,172 @@
 
 #include <GLFW/glfw3.h> // Key definitions for input handling
 
+#include <map>
+#include <cmath>
+#include <tuple>
+#include <algorithm>
+
+
+// Sizes of the cube shadow map pool
+static GLsizei const SHADOW_MAP_MIN_SIZE = 256;
+static GLsizei const SHADOW_MAP_MAX_SIZE = 4096;
+
+// The adaptive shadow map size changes once the desired size is this many 
+// octaves beyond the midpoint to the next size for SHADOW_RESIZE_FRAMES frames
+static float const SHADOW_RESIZE_HYSTERESIS = 0.25f;
+static uint32_t const SHADOW_RESIZE_FRAMES = 15;
+
+// Near plane of the linear depth shadow map relative to the light radius
+static float const SHADOW_LINEAR_NEAR_SCALE = 0.005f;
+
+// Priority factor of point lights which have moved since the last frame
+static float const POINT_SHADOW_MOVING_PRIORITY = 4.f;
 
 Renderer::Renderer() 
-	: m_shaderDefault(0)
-	, m_shaderDefaultNoShadow(0)
-	, m_shaderShadowMap(0)
-	, m_shadowMap()
+	: m_shaderDefault()
+	, m_shaderDefaultNoShadow()
+	, m_shaderDefaultBaked()
+	, m_shaderShadowMap()
+	, m_shaderShadowMapLayered()
+	, m_shaderShadowMapLinear()
+	, m_shaderShadowMapLayeredLinear()
+	, m_shaderShadowMapParaboloid()
+	, m_shaderShadowMapMoments()
+	, m_uniformsDefault()
+	, m_uniformsDefaultNoShadow()
+	, m_uniformsDefaultBaked()
+	, m_uniformsShadowMap()
+	, m_uniformsShadowMapLayered()
+	, m_uniformsShadowMapLinear()
+	, m_uniformsShadowMapLayeredLinear()
+	, m_uniformsShadowMapMoments()
+	, m_shadowUniforms(nullptr)
+	, m_uniformShadowHemisphere()
+	, m_frameUniformBuffer(0)
+	, m_pointLightUniformBuffer(0)
+	, m_transformBuffer(0)
+	, m_transformTexture(0)
+	, m_transforms()
+	, m_materialBuffer(0)
+	, m_materialTexture(0)
+	, m_materialCount(0)
+	, m_materialBindStates()
+	, m_stateCache()
+	, m_shadowMapPool()
+	, m_shadowMap(nullptr)
+	, m_shadowAdaptiveSize(true)
+	, m_shadowResizeFrames(0)
 	, m_useShadowMap(true)
 	, m_shadowCullFront(false)
 	, m_shadowUsePolygonOffset(true)
 	, m_shadowPolygonOffsetUnits(500.f)
 	, m_shadowPolygonOffsetFactor(1.f)
+	, m_shadowLinearOffsetUnits(4.f)
+	, m_shadowUseStaticCache(true)
+	, m_shadowCullByReceivers(true)
+	, m_shadowUseLayered(false)
+	, m_shadowLinearDepth(false)
+	, m_shadowFilter(SHADOW_FILTER_COMPARE)
+	, m_shadowUseSoftware(false)
+	, m_softwareShadowMap()
+	, m_visibleMeshes()
+	, m_visibleReceivers()
+	, m_visibleReceiverBounds()
+	, m_renderQueue()
+	, m_instanceData()
+	, m_instanceBuffer(0)
+	, m_multiDrawIndirectSupported(false)
+	, m_useMultiDrawIndirect(false)
+	, m_geometryArena()
+	, m_indirectCommands()
+	, m_indirectBuffer(0)
+	, m_staticFaceBatches()
+	, m_faceBatches()
+	, m_lightBatches()
+	, m_staticLayeredBatches()
+	, m_layeredBatches()
+	, m_staticShadowCasters()
+	, m_dynamicShadowCasters()
+	, m_shadowMapState()
+	, m_staticShadowMapState()
+	, m_momentMapState()
+	, m_shadowMapCasterBounds()
+	, m_usePointLights(false)
+	, m_shadowAllocator()
+	, m_pointShadowFramebuffer(0)
+	, m_pointShadowSlots()
+	, m_pointShadowStates()
+	, m_pointShadowFaceBudget(24)
+	, m_pointShadowRoundRobin(0)
+	, m_pointShadowCasters()
+	, m_pointShadowFaces()
+	, m_useBakedLighting(false)
+	, m_useBakedVisibility(false)
+	, m_lightBaker()
+	, m_bakedVisibilityBuffer(0)
+	, m_bakedVisibilityTexture(0)
+	, m_stats()
+	, m_totals()
 	, m_input(nullptr)
 {
 }
 
 Renderer::~Renderer()
 {
-	glDeleteShader(m_shaderDefault);
-	glDeleteShader(m_shaderDefaultNoShadow);
-	glDeleteShader(m_shaderShadowMap);
+	if (m_frameUniformBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_frameUniformBuffer);
+	}
+
+	if (m_pointLightUniformBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_pointLightUniformBuffer);
+	}
+
+	if (m_pointShadowFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_pointShadowFramebuffer);
+	}
+
+	if (m_transformTexture != 0)
+	{
+		glDeleteTextures(1, &m_transformTexture);
+	}
+
+	if (m_transformBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_transformBuffer);
+	}
+
+	if (m_materialTexture != 0)
+	{
+		glDeleteTextures(1, &m_materialTexture);
+	}
+
+	if (m_materialBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_materialBuffer);
+	}
+
+	if (m_instanceBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_instanceBuffer);
+	}
+
+	if (m_indirectBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_indirectBuffer);
+	}
+
+	if (m_bakedVisibilityTexture != 0)
+	{
+		glDeleteTextures(1, &m_bakedVisibilityTexture);
+	}
+
+	if (m_bakedVisibilityBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_bakedVisibilityBuffer);
+	}
 }
 
 void Renderer::init(Input* input)
@@ -39,19 +186,110 @@ void Renderer::init(Input* input)
 	glEnable(GL_CULL_FACE);
 	glClearColor(0, 0, 0, 1);
 
-	GLuint vsDefault = glUtil::loadShader("assets/shader/default.vert.glsl", GL_VERTEX_SHADER);
-	GLuint fsDefault = glUtil::loadShader("assets/shader/default.frag.glsl", GL_FRAGMENT_SHADER);
-	m_shaderDefault = glUtil::linkShaders(vsDefault, fsDefault);
+	// The moment cube map is filtered across face edges
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+	m_shaderDefault.init("assets/shader/default.vert.glsl", "assets/shader/default.frag.glsl");
+	m_uniformsDefault.init(m_shaderDefault);
+
+	m_shaderDefaultNoShadow.init("assets/shader/defaultNoShadow.vert.glsl", "assets/shader/defaultNoShadow.frag.glsl");
+	m_uniformsDefaultNoShadow.init(m_shaderDefaultNoShadow);
+
+	m_shaderShadowMap.init("assets/shader/shadowMap.vert.glsl", "assets/shader/shadowMap.frag.glsl");
+	m_uniformsShadowMap.init(m_shaderShadowMap);
+
+	m_shaderShadowMapLayered.init("assets/shader/shadowMapLayered.vert.glsl", "assets/shader/shadowMapLayered.geom.glsl", "assets/shader/shadowMap.frag.glsl");
+	m_uniformsShadowMapLayered.init(m_shaderShadowMapLayered);
+
+	m_shaderShadowMapLinear.init("assets/shader/shadowMap.vert.glsl", "assets/shader/shadowMapLinear.frag.glsl");
+	m_uniformsShadowMapLinear.init(m_shaderShadowMapLinear);
+
+	m_shaderShadowMapLayeredLinear.init("assets/shader/shadowMapLayered.vert.glsl", "assets/shader/shadowMapLayered.geom.glsl", "assets/shader/shadowMapLinear.frag.glsl");
+	m_uniformsShadowMapLayeredLinear.init(m_shaderShadowMapLayeredLinear);
+
+	m_shaderShadowMapParaboloid.init("assets/shader/shadowMapParaboloid.vert.glsl", "assets/shader/shadowMap.frag.glsl");
+	m_uniformShadowHemisphere = m_shaderShadowMapParaboloid.getUniform<float>("hemisphere");
+
+	m_shaderShadowMapMoments.init("assets/shader/shadowMap.vert.glsl", "assets/shader/shadowMapMoments.frag.glsl");
+	m_uniformsShadowMapMoments.init(m_shaderShadowMapMoments);
+
+	for (glUtil::ShaderProgram const* program : { 
+		&m_shaderDefault, &m_shaderDefaultNoShadow, 
+		&m_shaderShadowMap, &m_shaderShadowMapLayered, &m_shaderShadowMapLinear, &m_shaderShadowMapLayeredLinear, &m_shaderShadowMapParaboloid, 
+		&m_shaderShadowMapMoments })
+	{
+		setProgramBindings(*program);
+	}
+	glUseProgram(0);
+
+	// Frame uniform buffer
+	glGenBuffers(1, &m_frameUniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_frameUniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, glUtil::FRAME_BLOCK_BINDING, m_frameUniformBuffer);
+
+	// Point light uniform buffer
+	glGenBuffers(1, &m_pointLightUniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_pointLightUniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(PointLightBlock), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, glUtil::POINT_LIGHT_BLOCK_BINDING, m_pointLightUniformBuffer);
+
+	// Transform buffer. The texture stays bound to its own unit.
+	glGenBuffers(1, &m_transformBuffer);
+	glGenTextures(1, &m_transformTexture);
+	glActiveTexture(GL_TEXTURE0 + glUtil::TRANSFORM_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_transformTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_transformBuffer);
+	glActiveTexture(GL_TEXTURE0);
+
+	// Material buffer, same as the transform buffer
+	glGenBuffers(1, &m_materialBuffer);
+	glGenTextures(1, &m_materialTexture);
+	glActiveTexture(GL_TEXTURE0 + glUtil::MATERIAL_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_materialTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_materialBuffer);
+	glActiveTexture(GL_TEXTURE0);
 
-	GLuint vsDefaultNoShadow = glUtil::loadShader("assets/shader/defaultNoShadow.vert.glsl", GL_VERTEX_SHADER);
-	GLuint fsDefaultNoShadow = glUtil::loadShader("assets/shader/defaultNoShadow.frag.glsl", GL_FRAGMENT_SHADER);
-	m_shaderDefaultNoShadow = glUtil::linkShaders(vsDefaultNoShadow, fsDefaultNoShadow);
+	// Baked point light visibility, same as the transform buffer
+	glGenBuffers(1, &m_bakedVisibilityBuffer);
+	glGenTextures(1, &m_bakedVisibilityTexture);
+	glActiveTexture(GL_TEXTURE0 + glUtil::BAKED_VISIBILITY_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_bakedVisibilityTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, m_bakedVisibilityBuffer);
+	glActiveTexture(GL_TEXTURE0);
+
+	// Instance buffer, filled before each pass
+	glGenBuffers(1, &m_instanceBuffer);
+
+	// Multi draw indirect requires GL 4.3 or the extensions. Indirect draws
+	// also need base instance support to select the instance data.
+	m_multiDrawIndirectSupported = GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+	m_useMultiDrawIndirect = m_multiDrawIndirectSupported;
+	if (m_multiDrawIndirectSupported)
+	{
+		SPDLOG_INFO("Multi draw indirect supported");
+		glGenBuffers(1, &m_indirectBuffer);
+	}
+	else
+	{
+		SPDLOG_INFO("Multi draw indirect not supported, using one draw call per batch");
+	}
 
-	GLuint vsShadow = glUtil::loadShader("assets/shader/shadowMap.vert.glsl", GL_VERTEX_SHADER);
-	GLuint fsShadow = glUtil::loadShader("assets/shader/shadowMap.frag.glsl", GL_FRAGMENT_SHADER);
-	m_shaderShadowMap = glUtil::linkShaders(vsShadow, fsShadow);
+	// The neighbouring sizes are allocated up front, so that resizing by
+	// one step never waits for an allocation
+	m_shadowMap = &m_shadowMapPool[3]; // 2048
+	updateShadowMapPool();
 
-	m_shadowMap.init(2048);
+	// Point light shadow maps share a 256 MiB budget. The layers of the 
+	// tiers are attached to a depth only framebuffer one face at a time.
+	m_shadowAllocator.init({ 1024, 512, 256, 128 }, 256u << 20, MAX_POINT_LIGHTS);
+	glGenFramebuffers(1, &m_pointShadowFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_pointShadowFramebuffer);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Renderer::update()
@@ -59,22 +297,40 @@ void Renderer::update()
 	// Input handling for shadow map debugging
 	if (m_input->isPushed(GLFW_KEY_0))
 	{
+		invalidateShadowMaps();
 		m_useShadowMap = true;
 		m_shadowCullFront = false;
 		m_shadowUsePolygonOffset = true;
 		m_shadowPolygonOffsetUnits = 500.f;
+		m_shadowLinearOffsetUnits = 4.f;
 		m_shadowPolygonOffsetFactor = 1.f;
-		m_shadowMap.recreate(2048);
+		m_shadowUseStaticCache = true;
+		m_shadowCullByReceivers = true;
+		m_shadowUseLayered = false;
+		m_pointShadowFaceBudget = 24;
+		m_shadowAdaptiveSize = true;
+		setShadowMapSize(2048);
+		setShadowLinearDepth(false);
+		m_shadowFilter = SHADOW_FILTER_COMPARE;
+		m_shadowUseSoftware = false;
+		m_useBakedLighting = false;
 
 		SPDLOG_DEBUG("Shadow map enabled");
 		SPDLOG_DEBUG("Culling back face during shadow pass");
 		SPDLOG_DEBUG("glPolygonOffset enabled");
 		SPDLOG_DEBUG("uglPolygonOffset parameter: units = {}", m_shadowPolygonOffsetUnits);
 		SPDLOG_DEBUG("glPolygonOffset parameter: factor = {}", m_shadowPolygonOffsetFactor);
-		SPDLOG_DEBUG("Shadow map size = {}", m_shadowMap.m_size);
+		SPDLOG_DEBUG("Static shadow caster cache enabled");
+		SPDLOG_DEBUG("Shadow receiver culling enabled");
+		SPDLOG_DEBUG("Rendering shadow map faces one by one");
+		SPDLOG_DEBUG("Point light shadow face budget = {}", m_pointShadowFaceBudget);
+		SPDLOG_DEBUG("Adaptive shadow map size enabled");
+		SPDLOG_DEBUG("Shadow map size = {}", m_shadowMap->m_size);
+		SPDLOG_DEBUG("Storing perspective depth in the shadow map");
 	}
 	if (m_input->isPushed(GLFW_KEY_V))
 	{
+		invalidateShadowMaps();
 		m_useShadowMap = !m_useShadowMap;
 		if (m_useShadowMap)
 		{
@@ -87,6 +343,7 @@ void Renderer::update()
 	}
 	if (m_input->isPushed(GLFW_KEY_B))
 	{
+		invalidateShadowMaps();
 		m_shadowCullFront = !m_shadowCullFront;
 		if (m_shadowCullFront) 
 		{ 
@@ -99,6 +356,7 @@ void Renderer::update()
 	}
 	if (m_input->isPushed(GLFW_KEY_N))
 	{
+		invalidateShadowMaps();
 		m_shadowUsePolygonOffset = !m_shadowUsePolygonOffset;
 		if (m_shadowUsePolygonOffset)
 		{
@@ -111,216 +369,2091 @@ void Renderer::update()
 	}
 	if (m_input->isPushed(GLFW_KEY_1))
 	{
-		m_shadowPolygonOffsetUnits -= 100.f;
-		SPDLOG_DEBUG("glPolygonOffset parameter: units = {}", m_shadowPolygonOffsetUnits);
+		invalidateShadowMaps();
+		changeShadowOffsetUnits(-1.f);
 	}
 	if (m_input->isPushed(GLFW_KEY_2))
 	{
-		m_shadowPolygonOffsetUnits += 100.f;
-		SPDLOG_DEBUG("glPolygonOffset parameter: units = {}", m_shadowPolygonOffsetUnits);
+		invalidateShadowMaps();
+		changeShadowOffsetUnits(1.f);
 	}
 	if (m_input->isPushed(GLFW_KEY_3))
 	{
+		invalidateShadowMaps();
 		m_shadowPolygonOffsetFactor -= 1.0f;
 		SPDLOG_DEBUG("glPolygonOffset parameter: factor = {}", m_shadowPolygonOffsetFactor);
 	}
 	if (m_input->isPushed(GLFW_KEY_4))
 	{
+		invalidateShadowMaps();
 		m_shadowPolygonOffsetFactor += 1.0f;
 		SPDLOG_DEBUG("glPolygonOffset parameter: factor = {}", m_shadowPolygonOffsetFactor);
 	}
 	if (m_input->isPushed(GLFW_KEY_5))
 	{
-		if (m_shadowMap.m_size > 256)
+		// Choosing a size manually disables the adaptive size
+		m_shadowAdaptiveSize = false;
+		if (m_shadowMap->m_size > SHADOW_MAP_MIN_SIZE)
 		{
-			m_shadowMap.recreate(m_shadowMap.m_size / 2);
+			setShadowMapSize(m_shadowMap->m_size / 2);
 		}
-		SPDLOG_DEBUG("Shadow map size = {}", m_shadowMap.m_size);
+		SPDLOG_DEBUG("Shadow map size = {}", m_shadowMap->m_size);
 	}
 	if (m_input->isPushed(GLFW_KEY_6))
 	{
-		if (m_shadowMap.m_size < 4096)
+		m_shadowAdaptiveSize = false;
+		if (m_shadowMap->m_size < SHADOW_MAP_MAX_SIZE)
+		{
+			setShadowMapSize(m_shadowMap->m_size * 2);
+		}
+		SPDLOG_DEBUG("Shadow map size = {}", m_shadowMap->m_size);
+	}
+	if (m_input->isPushed(GLFW_KEY_9))
+	{
+		setShadowLinearDepth(!m_shadowLinearDepth);
+		if (m_shadowLinearDepth)
+		{
+			SPDLOG_DEBUG("Storing 16 bit linear distance in the shadow map");
+		}
+		else
+		{
+			SPDLOG_DEBUG("Storing perspective depth in the shadow map");
+		}
+		changeShadowOffsetUnits(0.f);
+		SPDLOG_DEBUG("glPolygonOffset parameter: factor = {}", m_shadowPolygonOffsetFactor);
+	}
+	if (m_input->isPushed(GLFW_KEY_F2))
+	{
+		// Cycle compare -> VSM -> EVSM
+		m_shadowFilter = static_cast<ShadowFilter>((m_shadowFilter + 1) % 3);
+		invalidateShadowMaps();
+		switch (m_shadowFilter)
+		{
+		default:
+		case SHADOW_FILTER_COMPARE:
+			SPDLOG_DEBUG("Shadow filter: depth comparison");
+			break;
+
+		case SHADOW_FILTER_VSM:
+			SPDLOG_DEBUG("Shadow filter: variance shadow map");
+			break;
+
+		case SHADOW_FILTER_EVSM:
+			SPDLOG_DEBUG("Shadow filter: exponential variance shadow map");
+			break;
+		}
+	}
+	if (m_input->isPushed(GLFW_KEY_F3))
+	{
+		// The CPU rasterizer writes perspective depth, so it is not used 
+		// while linear distance or a moment filter is selected
+		m_shadowUseSoftware = !m_shadowUseSoftware;
+		invalidateShadowMaps();
+		if (m_shadowUseSoftware)
+		{
+			SPDLOG_DEBUG("Rasterizing the cube shadow map on the CPU");
+		}
+		else
+		{
+			SPDLOG_DEBUG("Rasterizing the cube shadow map on the GPU");
+		}
+	}
+	if (m_input->isPushed(GLFW_KEY_F4))
+	{
+		m_useBakedLighting = !m_useBakedLighting;
+		if (m_useBakedLighting)
+		{
+			SPDLOG_DEBUG("Baked point light visibility enabled");
+			if (m_lightBaker.isEmpty())
+			{
+				SPDLOG_DEBUG("Nothing is baked yet, press F5 to bake");
+			}
+		}
+		else
+		{
+			SPDLOG_DEBUG("Baked point light visibility disabled");
+		}
+	}
+	if (m_input->isPushed(GLFW_KEY_E))
+	{
+		m_shadowAdaptiveSize = !m_shadowAdaptiveSize;
+		if (m_shadowAdaptiveSize)
+		{
+			SPDLOG_DEBUG("Adaptive shadow map size enabled");
+		}
+		else
+		{
+			SPDLOG_DEBUG("Adaptive shadow map size disabled");
+		}
+	}
+	if (m_input->isPushed(GLFW_KEY_C))
+	{
+		invalidateShadowMaps();
+		m_shadowUseStaticCache = !m_shadowUseStaticCache;
+		if (m_shadowUseStaticCache)
+		{
+			SPDLOG_DEBUG("Static shadow caster cache enabled");
+		}
+		else
+		{
+			SPDLOG_DEBUG("Static shadow caster cache disabled");
+		}
+	}
+	if (m_input->isPushed(GLFW_KEY_Y))
+	{
+		m_shadowUseLayered = !m_shadowUseLayered;
+		if (m_shadowUseLayered)
+		{
+			SPDLOG_DEBUG("Rendering all shadow map faces in one layered pass");
+		}
+		else
+		{
+			SPDLOG_DEBUG("Rendering shadow map faces one by one");
+		}
+	}
+	if (m_input->isPushed(GLFW_KEY_R))
+	{
+		invalidateShadowMaps();
+		m_shadowCullByReceivers = !m_shadowCullByReceivers;
+		if (m_shadowCullByReceivers)
+		{
+			SPDLOG_DEBUG("Shadow receiver culling enabled");
+		}
+		else
+		{
+			SPDLOG_DEBUG("Shadow receiver culling disabled");
+		}
+	}
+	if (m_input->isPushed(GLFW_KEY_G))
+	{
+		if (m_multiDrawIndirectSupported)
+		{
+			m_useMultiDrawIndirect = !m_useMultiDrawIndirect;
+			if (m_useMultiDrawIndirect)
+			{
+				SPDLOG_DEBUG("Multi draw indirect enabled");
+			}
+			else
+			{
+				SPDLOG_DEBUG("Multi draw indirect disabled");
+			}
+		}
+		else
+		{
+			SPDLOG_DEBUG("Multi draw indirect is not supported");
+		}
+	}
+	if (m_input->isPushed(GLFW_KEY_Q))
+	{
+		m_usePointLights = !m_usePointLights;
+		if (m_usePointLights)
+		{
+			SPDLOG_DEBUG("Additional point lights enabled");
+		}
+		else
+		{
+			SPDLOG_DEBUG("Additional point lights disabled");
+		}
+	}
+	if (m_input->isPushed(GLFW_KEY_7))
+	{
+		if (m_pointShadowFaceBudget > 6)
+		{
+			m_pointShadowFaceBudget -= 6;
+		}
+		SPDLOG_DEBUG("Point light shadow face budget = {}", m_pointShadowFaceBudget);
+	}
+	if (m_input->isPushed(GLFW_KEY_8))
+	{
+		if (m_pointShadowFaceBudget < 6 * MAX_POINT_LIGHTS)
 		{
-			m_shadowMap.recreate(m_shadowMap.m_size * 2);
+			m_pointShadowFaceBudget += 6;
 		}
-		SPDLOG_DEBUG("Shadow map size = {}", m_shadowMap.m_size);
+		SPDLOG_DEBUG("Point light shadow face budget = {}", m_pointShadowFaceBudget);
+	}
+	if (m_input->isPushed(GLFW_KEY_M))
+	{
+		printStats();
 	}
 }
 
 void Renderer::render(
 	SceneGraph const& scene,
 	LightSource const& light,
+	std::vector<LightSource> const& pointLights,
 	glm::mat4 viewMatrix,
 	float vfov,
 	int width,
 	int height,
 	float near,
 	float far
-) const
+)
 {
-	renderShadowPass(scene, light, near, far);
-	renderLightPass(scene, light, viewMatrix, vfov, width, height, near, far);
+	m_stats = {};
+	m_totals.frames++;
+
+	updateGeometryArena(scene);
+	updateMaterials(scene);
+
+	// A bake of other static nodes is not used
+	m_useBakedVisibility = 
+		m_useBakedLighting && m_useShadowMap && 
+		!m_lightBaker.isEmpty() && m_lightBaker.getStaticVersion() == scene.getStaticVersion();
+
+	// Objects created since the last frame (e.g. a recreated shadow map) were
+	// bound without the state cache
+	m_stateCache.invalidate();
+	m_stateCache.resetCounters();
+
+	// Camera projection and frustum
+	glm::mat4 projectionMatrix = glm::perspective(
+		vfov,
+		static_cast<float>(width) / static_cast<float>(height),
+		near, far
+	);
+	Frustum cameraFrustum(projectionMatrix * viewMatrix);
+
+	collectVisibleMeshes(scene, light, cameraFrustum);
+	sortVisibleMeshes(viewMatrix, far);
+	updateShadowMapSize(light, viewMatrix, vfov, height);
+
+	// Linear depth fits the near plane to the light radius instead of using
+	// the near plane of the camera
+	float shadowNear = m_shadowLinearDepth ? light.radius * SHADOW_LINEAR_NEAR_SCALE : near;
+	updateFrameUniforms(light, viewMatrix, projectionMatrix, shadowNear);
+	updateTransforms(scene);
+
+	renderShadowPass(scene, light, cameraFrustum, shadowNear);
+	renderPointLightShadows(scene, pointLights, viewMatrix, cameraFrustum, vfov, height, near);
+	updatePointLightUniforms(pointLights, viewMatrix, near);
+	renderLightPass(light, width, height);
+
+	m_stats.stateChangesIssued = m_stateCache.m_issuedCalls;
+	m_stats.stateChangesElided = m_stateCache.m_elidedCalls;
 }
 
-void Renderer::renderShadowPass(
-	SceneGraph const& scene, 
-	LightSource const& light, 
-	float near,
-	float far
-) const
+void Renderer::updateTransforms(SceneGraph const& scene)
 {
-	if (!m_useShadowMap)
+	m_transforms.clear();
+	for (SceneGraph::SceneNode const& node : scene.getNodes())
 	{
-		return;
+		m_transforms.push_back({ node.modelMatrix, glm::inverse(glm::transpose(node.modelMatrix)) });
 	}
 
-	// Load program
-	glUseProgram(m_shaderShadowMap);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, m_shadowMap.m_framebuffer);
-	glViewport(0, 0, m_shadowMap.m_size, m_shadowMap.m_size);
+	// Orphan the old storage, the previous frame may still read from it
+	glBindBuffer(GL_TEXTURE_BUFFER, m_transformBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, m_transforms.size() * sizeof(NodeTransform), m_transforms.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
 
-	if (m_shadowUsePolygonOffset)
+void Renderer::updateMaterials(SceneGraph const& scene)
+{
+	std::vector<std::unique_ptr<Material>> const& materials = scene.getMaterials();
+	if (materials.size() == m_materialCount)
 	{
-		glEnable(GL_POLYGON_OFFSET_FILL);
-		glPolygonOffset(m_shadowPolygonOffsetFactor, m_shadowPolygonOffsetUnits);
+		return;
 	}
 
-	if (m_shadowCullFront)
+	std::vector<MaterialUniforms> uniforms;
+	uniforms.reserve(materials.size());
+
+	// Materials which use the same texture arrays get the same bind state
+	std::map<std::tuple<GLuint, GLuint, GLuint>, uint16_t> bindStates;
+	m_materialBindStates.clear();
+	for (std::unique_ptr<Material> const& material : materials)
 	{
-		glCullFace(GL_FRONT);
+		uniforms.push_back(material->getUniforms());
+
+		auto textures = std::make_tuple(material->textureKa.texture, material->textureKd.texture, material->textureKs.texture);
+		auto it = bindStates.emplace(textures, static_cast<uint16_t>(bindStates.size())).first;
+		m_materialBindStates.push_back(it->second);
 	}
-	else
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m_materialBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, uniforms.size() * sizeof(MaterialUniforms), uniforms.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	m_materialCount = materials.size();
+
+	SPDLOG_DEBUG("Uploaded {} materials with {} texture bind states", materials.size(), bindStates.size());
+}
+
+void Renderer::updateFrameUniforms(
+	LightSource const& light,
+	glm::mat4 const& viewMatrix,
+	glm::mat4 const& projectionMatrix,
+	float near
+)
+{
+	FrameUniforms uniforms = {};
+	uniforms.projectionMatrix = projectionMatrix;
+	uniforms.viewMatrix = viewMatrix;
+	uniforms.shadowMapProjection = m_shadowMap->getProjectionMatrix(near, light.radius);
+	uniforms.lightPosition = glm::vec3(viewMatrix * glm::vec4(light.position, 1.0f));
+	uniforms.lightRadius = light.radius;
+	uniforms.lightPositionWorld = light.position;
+	uniforms.Ia = light.Ia;
+	uniforms.Id = light.Id;
+	uniforms.Is = light.Is;
+	uniforms.shadowMapType = light.shadowMapType;
+	uniforms.shadowNear = near;
+	uniforms.shadowLinearDepth = m_shadowLinearDepth;
+	uniforms.shadowFilter = m_shadowFilter;
+
+	// The tetrahedron frusta are looked up with positions relative to the light
+	glm::mat4 tetrahedronProjection = m_shadowMap->getTetrahedronProjectionMatrix(near, light.radius);
+	for (int face = 0; face < 4; ++face)
 	{
-		glCullFace(GL_BACK);
+		uniforms.tetrahedronViewProjections[face] = tetrahedronProjection * m_shadowMap->getTetrahedronViewMatrix(face, glm::vec3(0.f));
 	}
 
-	for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
-	{
-		// Bind texture and clear depth buffer
-		m_shadowMap.setCubeMapFace(face);
-		glClear(GL_DEPTH_BUFFER_BIT);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_frameUniformBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &uniforms);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Renderer::LightPassUniforms::init(glUtil::ShaderProgram const& program)
+{
+	lightInRange = program.getUniform<bool>("lightInRange");
+}
 
-		// Render the scene
-		glm::mat4 viewProjection = m_shadowMap.getProjectionMatrix(near, far) * 
-			                       m_shadowMap.getViewMatrix(face, light.position);
+void Renderer::ShadowPassUniforms::init(glUtil::ShaderProgram const& program)
+{
+	viewProjection = program.getUniform<glm::mat4>("viewProjection");
+	faceViewProjections = program.getUniform<std::array<glm::mat4, 6>>("faceViewProjections");
+	faceMask = program.getUniform<int>("faceMask");
+	depthOffset = program.getUniform<glm::vec2>("depthOffset");
+}
 
-		for (SceneGraph::SceneNode const& node : scene.getNodes())
-		{
-			if (!node.castsShadow)
-			{
-				continue;
-			}
+bool Renderer::ShadowMapState::matches(LightSource const& otherLight, uint64_t otherCasterVersion, float otherNear) const
+{
+	return
+		valid &&
+		light == &otherLight &&
+		lightVersion == otherLight.version &&
+		casterVersion == otherCasterVersion &&
+		near == otherNear;
+}
 
-			for (Mesh const* mesh : node.meshes)
-			{
-				// Bind vertex array object
-				glBindVertexArray(mesh->vertexArrayObject);
+bool Renderer::ShadowMapState::matchesLight(LightSource const& otherLight, float otherNear) const
+{
+	return
+		valid &&
+		light == &otherLight &&
+		lightVersion == otherLight.version &&
+		near == otherNear;
+}
 
-				// Pass uniforms
-				glm::mat4 modelViewProjection = viewProjection * node.modelMatrix;
-				glUniformMatrix4fv(glGetUniformLocation(m_shaderShadowMap, "modelViewProjection"), 1, GL_FALSE, glm::value_ptr(modelViewProjection));
+void Renderer::setProgramBindings(glUtil::ShaderProgram const& program)
+{
+	program.setUniformBlockBinding("FrameBlock", glUtil::FRAME_BLOCK_BINDING);
+	program.setUniformBlockBinding("PointLightBlock", glUtil::POINT_LIGHT_BLOCK_BINDING);
+	program.use();
+	glUtil::setUniform(program.getUniformLocation("transforms"), glUtil::TRANSFORM_TEXTURE_UNIT);
+	glUtil::setUniform(program.getUniformLocation("materials"), glUtil::MATERIAL_TEXTURE_UNIT);
+	glUtil::setUniform(program.getUniformLocation("shadowMap"), 0);
+	glUtil::setUniform(program.getUniformLocation("paraboloidShadowMap"), glUtil::PARABOLOID_SHADOW_TEXTURE_UNIT);
+	glUtil::setUniform(program.getUniformLocation("tetrahedralShadowMap"), glUtil::TETRAHEDRAL_SHADOW_TEXTURE_UNIT);
+	glUtil::setUniform(program.getUniformLocation("momentShadowMap"), glUtil::MOMENT_SHADOW_TEXTURE_UNIT);
+	glUtil::setUniform(program.getUniformLocation("bakedVisibility"), glUtil::BAKED_VISIBILITY_TEXTURE_UNIT);
+	glUtil::setUniform(program.getUniformLocation("texKa"), 1);
+	glUtil::setUniform(program.getUniformLocation("texKd"), 2);
+	glUtil::setUniform(program.getUniformLocation("texKs"), 3);
 
-				// Draw the mesh
-				glDrawElements(GL_TRIANGLES, mesh->numIndices, GL_UNSIGNED_INT, 0);
-			}
-		}
+	// The elements of a sampler array have consecutive locations
+	GLint pointShadowMaps = program.getUniformLocation("pointShadowMaps");
+	for (GLint i = 0; i < glUtil::POINT_SHADOW_TIER_COUNT && pointShadowMaps != -1; ++i)
+	{
+		glUtil::setUniform(pointShadowMaps + i, glUtil::POINT_SHADOW_TEXTURE_UNIT + i);
 	}
+}
 
-	if (m_shadowUsePolygonOffset)
+glUtil::ShaderProgram const& Renderer::getLightPassProgram() const
+{
+	if (!m_useShadowMap)
 	{
-		glDisable(GL_POLYGON_OFFSET_FILL);
+		return m_shaderDefaultNoShadow;
 	}
+
+	return m_useBakedVisibility ? m_shaderDefaultBaked : m_shaderDefault;
 }
 
-void Renderer::renderLightPass(
-	SceneGraph const& scene, 
-	LightSource const& light, 
-	glm::mat4 viewMatrix, 
-	float vfov,
-	int width,
-	int height,
-	float near,
-	float far
-) const
+Renderer::LightPassUniforms const& Renderer::getLightPassUniforms() const
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, width, height);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	
-	// Set GL state
-	glCullFace(GL_BACK);
-	glEnable(GL_MULTISAMPLE);
+	if (!m_useShadowMap)
+	{
+		return m_uniformsDefaultNoShadow;
+	}
 
-	// Load program
-	GLuint currentShader = m_useShadowMap ? m_shaderDefault : m_shaderDefaultNoShadow;
-	glUseProgram(currentShader);
+	return m_useBakedVisibility ? m_uniformsDefaultBaked : m_uniformsDefault;
+}
 
-	if (m_useShadowMap)
+void Renderer::invalidateShadowMaps()
+{
+	m_shadowMapState.valid = false;
+	m_staticShadowMapState.valid = false;
+	m_momentMapState.valid = false;
+	for (PointShadowState& state : m_pointShadowStates)
 	{
-		// Shadow map texture (unit 0)
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, m_shadowMap.m_cubeMap);
-		glUniform1i(glGetUniformLocation(currentShader, "shadowMap"), 0);
-
-		// Shadow map uniforms
-		glUniform3fv(glGetUniformLocation(currentShader, "lightPositionWorld"), 1, glm::value_ptr(light.position));
-		glUniformMatrix4fv(glGetUniformLocation(currentShader, "shadowMapProjection"), 1, GL_FALSE, glm::value_ptr(m_shadowMap.getProjectionMatrix(near, far)));
+		for (PointShadowFaceState& faceState : state.faces)
+		{
+			faceState.current = false;
+		}
 	}
+}
 
-	// Projection matrix uniform
-	glm::mat4 projectionMatrix = glm::perspective(
-		vfov,
-		static_cast<float>(width) / static_cast<float>(height),
-		near, far
-	);
-	glUniformMatrix4fv(glGetUniformLocation(currentShader, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+void Renderer::setShadowMapSize(GLsizei size)
+{
+	for (size_t i = 0; i < m_shadowMapPool.size(); ++i)
+	{
+		glUtil::ShadowMap& shadowMap = m_shadowMapPool[i];
+		if ((SHADOW_MAP_MIN_SIZE << i) == size && &shadowMap != m_shadowMap)
+		{
+			// Only the map in use keeps its moment map, which is created again
+			// on demand. The cache may still hold the deleted texture.
+			m_shadowMap->releaseMomentCubeMap();
+			m_stateCache.invalidate();
 
-	// Light uniforms
-	glUniform3fv(glGetUniformLocation(currentShader, "lightPosition"), 1, glm::value_ptr(glm::vec3(viewMatrix * glm::vec4(light.position, 1.0f))));
-	glUniform4fv(glGetUniformLocation(currentShader, "Ia"), 1, glm::value_ptr(light.Ia));
-	glUniform4fv(glGetUniformLocation(currentShader, "Id"), 1, glm::value_ptr(light.Id));
-	glUniform4fv(glGetUniformLocation(currentShader, "Is"), 1, glm::value_ptr(light.Is));
+			// The map may hold the depth of an earlier frame. The point light
+			// shadow maps are not affected by the size.
+			m_shadowMap = &shadowMap;
+			m_shadowMapState.valid = false;
+			m_staticShadowMapState.valid = false;
+			m_momentMapState.valid = false;
+			m_totals.shadowMapResizes++;
+			updateShadowMapPool();
+			return;
+		}
+	}
+}
 
-	for (SceneGraph::SceneNode const& node : scene.getNodes())
+void Renderer::updateShadowMapPool()
+{
+	size_t current = static_cast<size_t>(m_shadowMap - m_shadowMapPool.data());
+	for (size_t i = 0; i < m_shadowMapPool.size(); ++i)
 	{
-		for (Mesh const* mesh : node.meshes)
+		glUtil::ShadowMap& shadowMap = m_shadowMapPool[i];
+		bool resident = i + 1 >= current && i <= current + 1;
+		if (resident && shadowMap.m_cubeMap == 0)
 		{
-			glBindVertexArray(mesh->vertexArrayObject);
-
-			// Transformation matrices
-			glm::mat4 const& modelMatrix = node.modelMatrix;
-			glm::mat4 modelViewMatrix = viewMatrix * modelMatrix;
-			glm::mat4 normalMatrix = glm::inverse(glm::transpose(modelViewMatrix));
-			glUniformMatrix4fv(glGetUniformLocation(currentShader, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-			glUniformMatrix4fv(glGetUniformLocation(currentShader, "viewMatrix"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
-			glUniformMatrix4fv(glGetUniformLocation(currentShader, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-
-			// Material uniforms
-			Material const& material = mesh->material;
-			glUniform4fv(glGetUniformLocation(currentShader, "ka"), 1, glm::value_ptr(material.Ka));
-			glUniform4fv(glGetUniformLocation(currentShader, "kd"), 1, glm::value_ptr(material.Kd));
-			glUniform4fv(glGetUniformLocation(currentShader, "ks"), 1, glm::value_ptr(material.Ks));
-			glUniform1f(glGetUniformLocation(currentShader, "hasTexKa"), material.textureKa != 0);
-			glUniform1f(glGetUniformLocation(currentShader, "hasTexKd"), material.textureKd != 0);
-			glUniform1f(glGetUniformLocation(currentShader, "hasTexKs"), material.textureKs != 0);
-			glUniform1f(glGetUniformLocation(currentShader, "shininess"), material.Ns);
-
-			// Material textures
-			glUniform1i(glGetUniformLocation(currentShader, "texKa"), 1);
-			glUniform1i(glGetUniformLocation(currentShader, "texKd"), 2);
-			glUniform1i(glGetUniformLocation(currentShader, "texKs"), 3);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, material.textureKa);
-			glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, material.textureKd);
-			glActiveTexture(GL_TEXTURE3);
-			glBindTexture(GL_TEXTURE_2D, material.textureKs);
-
-			// Draw the mesh
-			glDrawElements(GL_TRIANGLES, mesh->numIndices, GL_UNSIGNED_INT, 0);
+			shadowMap.init(SHADOW_MAP_MIN_SIZE << i);
+		}
+		else if (!resident && shadowMap.m_cubeMap != 0)
+		{
+			shadowMap.release();
 		}
 	}
 
-	glDisable(GL_MULTISAMPLE);
+	// Creating and deleting the maps changes the bound framebuffer and textures
+	m_stateCache.invalidate();
+}
+
+void Renderer::setShadowLinearDepth(bool linearDepth)
+{
+	m_shadowLinearDepth = linearDepth;
+	for (glUtil::ShadowMap& shadowMap : m_shadowMapPool)
+	{
+		shadowMap.setDepthFormat(m_shadowLinearDepth ? GL_DEPTH_COMPONENT16 : GL_DEPTH_COMPONENT);
+	}
+	invalidateShadowMaps();
+}
+
+void Renderer::changeShadowOffsetUnits(float steps)
+{
+	// The units are steps of the depth format. Linear depth spreads the steps
+	// evenly over the light radius and needs a much smaller offset. Only 
+	// the cube map pass writes linear depth, all other passes keep theirs.
+	if (m_shadowLinearDepth)
+	{
+		m_shadowLinearOffsetUnits += steps;
+		SPDLOG_DEBUG("Linear depth offset parameter: units = {}", m_shadowLinearOffsetUnits);
+	}
+	else
+	{
+		m_shadowPolygonOffsetUnits += 100.f * steps;
+		SPDLOG_DEBUG("glPolygonOffset parameter: units = {}", m_shadowPolygonOffsetUnits);
+	}
+}
+
+void Renderer::useShadowProgram(glUtil::ShaderProgram const& program, ShadowPassUniforms const& uniforms)
+{
+	m_stateCache.useProgram(program.m_program);
+	m_shadowUniforms = &uniforms;
+}
+
+void Renderer::updateShadowMapSize(LightSource const& light, glm::mat4 const& viewMatrix, float vfov, int height)
+{
+	if (!m_shadowAdaptiveSize || !m_useShadowMap || m_visibleReceivers.empty())
+	{
+		m_shadowResizeFrames = 0;
+		m_stats.shadowMapSize = m_shadowMap->m_size;
+		return;
+	}
+
+	// Extent of the visible lit region around the light
+	BoundingBox lightBounds(light.position - glm::vec3(light.radius), light.position + glm::vec3(light.radius));
+	BoundingBox receivers(glm::max(m_visibleReceiverBounds.min, lightBounds.min), glm::min(m_visibleReceiverBounds.max, lightBounds.max));
+	float extent = 0.f;
+	for (unsigned i = 0; i < 8; ++i)
+	{
+		extent = std::max(extent, glm::distance(receivers.getCorner(i), light.position));
+	}
+	extent = std::min(extent, light.radius);
+
+	// A texel of a cube face spans 2 * d / size at the distance d from the 
+	// light, a pixel spans 2 * tan(vfov / 2) * D / height at the distance D 
+	// from the camera. Both are matched at the edge of the lit region as 
+	// seen from the light position. A camera inside the region is treated 
+	// as if it was at its edge.
+	glm::vec3 cameraPosition = glm::vec3(glm::inverse(viewMatrix)[3]);
+	float distance = std::max(glm::distance(cameraPosition, light.position), extent);
+	float desiredSize = std::max(extent * static_cast<float>(height) / (distance * std::tan(vfov * 0.5f)), 1.f);
+	m_stats.shadowMapDesiredSize = desiredSize;
+
+	// Octaves between the desired and the current size
+	float octaves = std::log2(desiredSize / static_cast<float>(m_shadowMap->m_size));
+	GLsizei size = m_shadowMap->m_size;
+	if (octaves > 0.5f + SHADOW_RESIZE_HYSTERESIS && size < SHADOW_MAP_MAX_SIZE)
+	{
+		size *= 2;
+	}
+	else if (octaves < -0.5f - SHADOW_RESIZE_HYSTERESIS && size > SHADOW_MAP_MIN_SIZE)
+	{
+		size /= 2;
+	}
+
+	// The size changes by one step once the estimate has been beyond the
+	// threshold for long enough
+	if (size == m_shadowMap->m_size)
+	{
+		m_shadowResizeFrames = 0;
+	}
+	else if (++m_shadowResizeFrames >= SHADOW_RESIZE_FRAMES)
+	{
+		m_shadowResizeFrames = 0;
+		setShadowMapSize(size);
+		SPDLOG_DEBUG("Shadow map size = {} (desired {:.0f})", m_shadowMap->m_size, desiredSize);
+	}
+	m_stats.shadowMapSize = m_shadowMap->m_size;
+}
+
+void Renderer::collectVisibleMeshes(SceneGraph const& scene, LightSource const& light, Frustum const& cameraFrustum)
+{
+	m_visibleMeshes.clear();
+	m_visibleReceivers.clear();
+	m_visibleReceiverBounds = BoundingBox();
+
+	for (SceneGraph::SceneNode const& node : scene.getNodes())
+	{
+		for (size_t i = 0; i < node.meshes.size(); ++i)
+		{
+			BoundingBox const& bounds = node.meshBounds[i];
+			if (!cameraFrustum.intersects(bounds))
+			{
+				m_stats.lightMeshesCulled++;
+				continue;
+			}
+
+			uint64_t id = (static_cast<uint64_t>(node.index) << 32) | i;
+			m_visibleMeshes.push_back({ node.meshes[i], static_cast<uint32_t>(node.index), bounds, id });
+
+			// Only meshes within the light radius can receive a shadow
+			if (bounds.intersectsSphere(light.position, light.radius))
+			{
+				m_visibleReceivers.push_back(bounds);
+				m_visibleReceiverBounds.extend(bounds);
+			}
+		}
+	}
+}
+
+uint32_t Renderer::collectCastersInRadius(SceneGraph const& scene, LightSource const& light, std::vector<ShadowCaster>& staticCasters, std::vector<ShadowCaster>& dynamicCasters)
+{
+	uint32_t outsideRadius = 0;
+	for (SceneGraph::SceneNode const& node : scene.getNodes())
+	{
+		if (!node.castsShadow)
+		{
+			continue;
+		}
+
+		for (size_t i = 0; i < node.meshes.size(); ++i)
+		{
+			// Casters outside of the light radius can never end up in the shadow map
+			if (!node.meshBounds[i].intersectsSphere(light.position, light.radius))
+			{
+				outsideRadius++;
+				continue;
+			}
+
+			uint64_t id = (static_cast<uint64_t>(node.index) << 32) | i;
+			ShadowCaster caster = { { node.meshes[i], static_cast<uint32_t>(node.index), node.meshBounds[i], id }, true, false };
+			if (node.isStatic)
+			{
+				staticCasters.push_back(caster);
+			}
+			else
+			{
+				dynamicCasters.push_back(caster);
+			}
+		}
+	}
+
+	return outsideRadius;
+}
+
+void Renderer::collectShadowCasters(SceneGraph const& scene, LightSource const& light, Frustum const& cameraFrustum)
+{
+	m_staticShadowCasters.clear();
+	m_dynamicShadowCasters.clear();
+	m_stats.shadowCastersOutsideRadius += collectCastersInRadius(scene, light, m_staticShadowCasters, m_dynamicShadowCasters);
+
+	// Check whether the shadow of the casters can reach a visible receiver
+	if (m_shadowCullByReceivers)
+	{
+		for (std::vector<ShadowCaster>* casters : { &m_staticShadowCasters, &m_dynamicShadowCasters })
+		{
+			for (ShadowCaster& caster : *casters)
+			{
+				BoundingBox shadowBounds = getShadowVolumeBounds(caster.bounds, light);
+				caster.reachesVisibleReceiver = 
+					shadowBounds.intersects(m_visibleReceiverBounds) && 
+					cameraFrustum.intersects(shadowBounds);
+
+				if (!caster.reachesVisibleReceiver)
+				{
+					m_stats.shadowCastersWithoutReceiver++;
+				}
+			}
+		}
+	}
+
+	sortShadowCasters(m_staticShadowCasters, light);
+	sortShadowCasters(m_dynamicShadowCasters, light);
+}
+
+// Reorders the draws to match the sorted render queue
+template <typename T>
+static void applyQueueOrder(RenderQueue const& queue, std::vector<T>& draws)
+{
+	std::vector<T> sorted;
+	sorted.reserve(draws.size());
+	for (RenderQueue::Item const& item : queue.getItems())
+	{
+		sorted.push_back(draws[item.index]);
+	}
+	draws.swap(sorted);
+}
+
+void Renderer::sortVisibleMeshes(glm::mat4 const& viewMatrix, float far)
+{
+	GLuint program = getLightPassProgram().m_program;
+
+	m_renderQueue.clear();
+	for (uint32_t i = 0; i < m_visibleMeshes.size(); ++i)
+	{
+		MeshInstance const& instance = m_visibleMeshes[i];
+
+		// View space depth of the bounds center
+		float depth = -(viewMatrix * glm::vec4(instance.bounds.getCenter(), 1.f)).z;
+
+		m_renderQueue.push(RenderQueue::makeKey(
+			LIGHT_PASS,
+			program,
+			m_materialBindStates[instance.mesh->material.index],
+			instance.mesh->vertexArrayObject,
+			depth,
+			far
+		), i);
+	}
+	m_renderQueue.sort();
+
+	applyQueueOrder(m_renderQueue, m_visibleMeshes);
+}
+
+void Renderer::sortShadowCasters(std::vector<ShadowCaster>& casters, LightSource const& light)
+{
+	m_renderQueue.clear();
+	for (uint32_t i = 0; i < casters.size(); ++i)
+	{
+		ShadowCaster const& caster = casters[i];
+
+		// The material does not affect the shadow pass
+		float depth = glm::distance(caster.bounds.getCenter(), light.position);
+		m_renderQueue.push(RenderQueue::makeKey(
+			SHADOW_PASS,
+			m_shaderShadowMap.m_program,
+			0,
+			caster.mesh->vertexArrayObject,
+			depth,
+			light.radius
+		), i);
+	}
+	m_renderQueue.sort();
+
+	applyQueueOrder(m_renderQueue, casters);
+}
+
+BoundingBox Renderer::getShadowVolumeBounds(BoundingBox const& casterBounds, LightSource const& light)
+{
+	BoundingBox lightBounds(light.position - glm::vec3(light.radius), light.position + glm::vec3(light.radius));
+
+	// If the light is inside the caster, the shadow may fall in any direction
+	if (casterBounds.intersectsSphere(light.position, 0.f))
+	{
+		return lightBounds;
+	}
+
+	// Extrude the corners of the caster away from the light. Each corner is
+	// moved onto the plane which touches the light sphere in the direction of
+	// the caster center. The convex hull of the caster and the extruded corners 
+	// contains the part of the shadow volume which is inside the light sphere.
+	glm::vec3 centerDirection = glm::normalize(casterBounds.getCenter() - light.position);
+	BoundingBox shadowBounds = casterBounds;
+	for (unsigned i = 0; i < 8; ++i)
+	{
+		glm::vec3 direction = glm::normalize(casterBounds.getCorner(i) - light.position);
+		float cosAngle = glm::dot(direction, centerDirection);
+
+		// The caster covers a large solid angle. Fall back to the light bounds.
+		if (cosAngle < 0.2f)
+		{
+			return lightBounds;
+		}
+
+		shadowBounds.extend(light.position + direction * (light.radius / cosAngle));
+	}
+
+	// Nothing outside of the light sphere is shadowed
+	return BoundingBox(glm::max(shadowBounds.min, lightBounds.min), glm::min(shadowBounds.max, lightBounds.max));
+}
+
+bool Renderer::hasVisibleReceivers(Frustum const& faceFrustum) const
+{
+	for (BoundingBox const& receiver : m_visibleReceivers)
+	{
+		if (faceFrustum.intersects(receiver))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Renderer::markDirtyShadowMapFaces(
+	std::vector<ShadowCaster>& casters,
+	std::unordered_map<uint64_t, BoundingBox>& previousCasterBounds,
+	std::vector<Frustum> const& faceFrusta
+)
+{
+	for (ShadowCaster& caster : casters)
+	{
+		// Casters which have not moved since they were rendered are still 
+		// correct, even if they do not reach a visible receiver anymore
+		bool unchanged = false;
+		auto previous = previousCasterBounds.find(caster.id);
+		if (previous != previousCasterBounds.end())
+		{
+			unchanged = previous->second.min == caster.bounds.min && previous->second.max == caster.bounds.max;
+			if (!unchanged)
+			{
+				markDirtyShadowMapFaces(previous->second, faceFrusta);
+			}
+			previousCasterBounds.erase(previous);
+		}
+
+		caster.inShadowMap = unchanged || caster.reachesVisibleReceiver;
+		if (caster.inShadowMap)
+		{
+			if (!unchanged)
+			{
+				markDirtyShadowMapFaces(caster.bounds, faceFrusta);
+			}
+			m_shadowMapCasterBounds.emplace(caster.id, caster.bounds);
+		}
+	}
+}
+
+void Renderer::markDirtyShadowMapFaces(BoundingBox const& bounds, std::vector<Frustum> const& faceFrusta)
+{
+	for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
+	{
+		if (faceFrusta[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X].intersects(bounds))
+		{
+			m_shadowMap->markFaceDirty(face);
+		}
+	}
+}
+
+void Renderer::markDirtyPointShadowFaces(SceneGraph const& scene, LightSource const& light, float near, PointShadowState& state)
+{
+	std::vector<ShadowCaster> casters;
+	collectCastersInRadius(scene, light, casters, casters);
+
+	glm::mat4 projection = m_shadowMap->getProjectionMatrix(near, light.radius);
+	std::vector<Frustum> faceFrusta;
+	for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
+	{
+		faceFrusta.emplace_back(projection * m_shadowMap->getViewMatrix(face, light.position));
+	}
+
+	auto markDirty = [&faceFrusta, &state](BoundingBox const& bounds) {
+		for (size_t face = 0; face < 6; ++face)
+		{
+			if (faceFrusta[face].intersects(bounds))
+			{
+				state.faces[face].casterDirty = true;
+			}
+		}
+	};
+
+	// Casters which left the radius leave their old bounds behind
+	std::unordered_map<uint64_t, BoundingBox> previousCasterBounds;
+	previousCasterBounds.swap(state.casterBounds);
+	for (ShadowCaster const& caster : casters)
+	{
+		auto previous = previousCasterBounds.find(caster.id);
+		if (previous == previousCasterBounds.end())
+		{
+			markDirty(caster.bounds);
+		}
+		else
+		{
+			if (previous->second.min != caster.bounds.min || previous->second.max != caster.bounds.max)
+			{
+				markDirty(previous->second);
+				markDirty(caster.bounds);
+			}
+			previousCasterBounds.erase(previous);
+		}
+		state.casterBounds.emplace(caster.id, caster.bounds);
+	}
+	for (auto const& previous : previousCasterBounds)
+	{
+		markDirty(previous.second);
+	}
+}
+
+void Renderer::renderShadowPass(
+	SceneGraph const& scene, 
+	LightSource const& light, 
+	Frustum const& cameraFrustum,
+	float near
+)
+{
+	if (!m_useShadowMap)
+	{
+		return;
+	}
+
+	collectShadowCasters(scene, light, cameraFrustum);
+
+	if (light.shadowMapType != SHADOW_MAP_CUBE)
+	{
+		renderParameterizedShadowPass(scene, light, near);
+		return;
+	}
+
+	if (m_shadowFilter != SHADOW_FILTER_COMPARE)
+	{
+		renderMomentShadowPass(scene, light, near);
+		return;
+	}
+
+	if (m_shadowUseSoftware && !m_shadowLinearDepth)
+	{
+		renderSoftwareShadowPass(scene, light, near);
+		return;
+	}
+
+	// Static casters are only cached if there are dynamic casters. Otherwise 
+	// everything is rendered directly into the shadow map.
+	bool useStaticCache = m_shadowUseStaticCache && !m_dynamicShadowCasters.empty();
+
+	// The far plane is set to the light radius
+	glm::mat4 projection = m_shadowMap->getProjectionMatrix(near, light.radius);
+
+	std::array<glm::mat4, 6> faceViewProjections;
+	std::vector<Frustum> faceFrusta;
+	for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
+	{
+		faceViewProjections[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X] = projection * m_shadowMap->getViewMatrix(face, light.position);
+		faceFrusta.emplace_back(faceViewProjections[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X]);
+	}
+
+	// A changed light invalidates all faces
+	if (!m_shadowMapState.matchesLight(light, near))
+	{
+		m_shadowMap->markAllFacesDirty();
+		m_shadowMapCasterBounds.clear();
+	}
+
+	// Re-render the static casters only if the light or a static caster has changed
+	bool updateStaticCache = useStaticCache && !m_staticShadowMapState.matches(light, scene.getStaticCasterVersion(), near);
+	if (updateStaticCache)
+	{
+		m_shadowMap->markAllFacesDirty();
+	}
+
+	// Only faces containing the old or new bounds of a changed caster need 
+	// to be re-rendered. Casters which are not rendered directly into the 
+	// shadow map anymore leave their old bounds behind.
+	std::unordered_map<uint64_t, BoundingBox> previousCasterBounds;
+	previousCasterBounds.swap(m_shadowMapCasterBounds);
+	markDirtyShadowMapFaces(m_dynamicShadowCasters, previousCasterBounds, faceFrusta);
+	if (!useStaticCache)
+	{
+		markDirtyShadowMapFaces(m_staticShadowCasters, previousCasterBounds, faceFrusta);
+	}
+	for (auto const& previous : previousCasterBounds)
+	{
+		markDirtyShadowMapFaces(previous.second, faceFrusta);
+	}
+
+	m_shadowMapState = { true, &light, light.version, scene.getCasterVersion(), near };
+
+	// Dirty faces which do not see any visible receiver are not rendered and
+	// stay dirty until a receiver in their direction becomes visible
+	std::vector<GLenum> faces;
+	uint8_t faceMask = 0;
+	for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
+	{
+		if (!m_shadowMap->isFaceDirty(face))
+		{
+			continue;
+		}
+
+		if (m_shadowCullByReceivers && !hasVisibleReceivers(faceFrusta[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X]))
+		{
+			m_stats.shadowFacesSkipped++;
+			continue;
+		}
+
+		faces.push_back(face);
+		faceMask |= 1 << (face - GL_TEXTURE_CUBE_MAP_POSITIVE_X);
+	}
+
+	// Reuse the shadow map of the last frame if no face needs to be rendered
+	if (faces.empty() && !updateStaticCache)
+	{
+		m_stats.shadowMapReused = true;
+		m_totals.shadowMapUpdatesSkipped++;
+		return;
+	}
+
+	// Load program
+	if (m_shadowUseLayered && m_shadowLinearDepth)
+	{
+		useShadowProgram(m_shaderShadowMapLayeredLinear, m_uniformsShadowMapLayeredLinear);
+	}
+	else if (m_shadowUseLayered)
+	{
+		useShadowProgram(m_shaderShadowMapLayered, m_uniformsShadowMapLayered);
+	}
+	else if (m_shadowLinearDepth)
+	{
+		useShadowProgram(m_shaderShadowMapLinear, m_uniformsShadowMapLinear);
+	}
+	else
+	{
+		useShadowProgram(m_shaderShadowMap, m_uniformsShadowMap);
+	}
+
+	m_stateCache.bindFramebuffer(m_shadowMap->m_framebuffer);
+	glViewport(0, 0, m_shadowMap->m_size, m_shadowMap->m_size);
+
+	// The linear depth programs write the depth and apply the offset themselves
+	if (m_shadowLinearDepth)
+	{
+		glm::vec2 offset(m_shadowPolygonOffsetFactor, m_shadowLinearOffsetUnits);
+		m_shadowUniforms->depthOffset.set(m_shadowUsePolygonOffset ? offset : glm::vec2(0.f));
+	}
+	else if (m_shadowUsePolygonOffset)
+	{
+		m_stateCache.enablePolygonOffset(m_shadowPolygonOffsetFactor, m_shadowPolygonOffsetUnits);
+	}
+
+	if (m_shadowCullFront)
+	{
+		m_stateCache.setCullFace(GL_FRONT);
+	}
+	else
+	{
+		m_stateCache.setCullFace(GL_BACK);
+	}
+
+	// Collect the batches of all faces and upload their instance data at once
+	m_instanceData.clear();
+	m_indirectCommands.clear();
+	for (size_t i = 0; i < 6; ++i)
+	{
+		m_staticFaceBatches[i].clear();
+		m_faceBatches[i].clear();
+	}
+	m_staticLayeredBatches.clear();
+	m_layeredBatches.clear();
+	if (m_shadowUseLayered)
+	{
+		// Casters are submitted once for all faces they intersect
+		if (updateStaticCache)
+		{
+			appendShadowBatches(m_staticShadowCasters, faceFrusta, 0x3F, false, m_staticLayeredBatches);
+		}
+		if (!useStaticCache)
+		{
+			appendShadowBatches(m_staticShadowCasters, faceFrusta, faceMask, true, m_layeredBatches);
+		}
+		appendShadowBatches(m_dynamicShadowCasters, faceFrusta, faceMask, true, m_layeredBatches);
+	}
+	else
+	{
+		for (size_t i = 0; i < 6; ++i)
+		{
+			if (updateStaticCache)
+			{
+				appendShadowBatches(m_staticShadowCasters, faceFrusta, 1 << i, false, m_staticFaceBatches[i]);
+			}
+		}
+		for (GLenum face : faces)
+		{
+			size_t i = face - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+			if (!useStaticCache)
+			{
+				appendShadowBatches(m_staticShadowCasters, faceFrusta, 1 << i, true, m_faceBatches[i]);
+			}
+			appendShadowBatches(m_dynamicShadowCasters, faceFrusta, 1 << i, true, m_faceBatches[i]);
+		}
+	}
+	uploadInstanceData();
+
+	if (updateStaticCache)
+	{
+		if (m_shadowUseLayered)
+		{
+			// Clearing the layered attachment clears all faces
+			m_shadowMap->setStaticCubeMapLayered();
+			glClear(GL_DEPTH_BUFFER_BIT);
+			renderLayeredShadowBatches(m_staticLayeredBatches, faceViewProjections, 0x3F);
+		}
+		else
+		{
+			for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
+			{
+				m_shadowMap->setStaticCubeMapFace(face);
+				glClear(GL_DEPTH_BUFFER_BIT);
+				renderShadowBatches(m_staticFaceBatches[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X], faceViewProjections[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X]);
+			}
+		}
+
+		m_staticShadowMapState = { true, &light, light.version, scene.getStaticCasterVersion(), near };
+		m_stats.staticShadowMapUpdated = true;
+		m_totals.staticShadowMapUpdates++;
+	}
+
+	for (GLenum face : faces)
+	{
+		// Bind texture
+		m_shadowMap->setCubeMapFace(face);
+
+		if (useStaticCache)
+		{
+			// Start with the depth of the static casters and add the dynamic ones
+			m_shadowMap->copyStaticCubeMapFace(face);
+		}
+		else
+		{
+			// Clear depth buffer
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+
+		if (!m_shadowUseLayered)
+		{
+			renderShadowBatches(m_faceBatches[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X], faceViewProjections[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X]);
+		}
+
+		m_shadowMap->clearFaceDirty(face);
+		m_stats.shadowFacesRendered++;
+	}
+
+	// The faces are prepared one by one, then filled in a single submission
+	if (m_shadowUseLayered && !faces.empty())
+	{
+		m_shadowMap->setCubeMapLayered();
+		renderLayeredShadowBatches(m_layeredBatches, faceViewProjections, faceMask);
+	}
+
+	m_stateCache.disablePolygonOffset();
+
+	m_totals.shadowMapUpdates++;
+	m_totals.shadowFacesRendered += faces.size();
+}
+
+void Renderer::renderMomentShadowPass(
+	SceneGraph const& scene, 
+	LightSource const& light, 
+	float near
+)
+{
+	// Reuse the moments of the last frame if neither the light nor a caster has changed
+	if (m_momentMapState.matches(light, scene.getCasterVersion(), near))
+	{
+		m_stats.shadowMapReused = true;
+		m_totals.shadowMapUpdatesSkipped++;
+		return;
+	}
+	m_momentMapState = { true, &light, light.version, scene.getCasterVersion(), near };
+
+	// Creating the moment map binds its objects without the state cache
+	if (m_shadowMap->m_momentMap == 0)
+	{
+		m_shadowMap->createMomentCubeMap();
+		m_stateCache.invalidate();
+	}
+	m_stateCache.bindFramebuffer(m_shadowMap->m_momentFramebuffer);
+	GLsizei size = m_shadowMap->getMomentMapSize();
+	glViewport(0, 0, size, size);
+
+	// The moments are filtered instead of offset, so no polygon offset is used
+	if (m_shadowCullFront)
+	{
+		m_stateCache.setCullFace(GL_FRONT);
+	}
+	else
+	{
+		m_stateCache.setCullFace(GL_BACK);
+	}
+
+	glm::mat4 projection = m_shadowMap->getProjectionMatrix(near, light.radius);
+	std::array<glm::mat4, 6> faceViewProjections;
+	std::vector<Frustum> faceFrusta;
+	for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
+	{
+		faceViewProjections[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X] = projection * m_shadowMap->getViewMatrix(face, light.position);
+		faceFrusta.emplace_back(faceViewProjections[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X]);
+	}
+
+	// All faces are rendered since the mipmaps depend on every face
+	m_instanceData.clear();
+	m_indirectCommands.clear();
+	for (size_t i = 0; i < 6; ++i)
+	{
+		m_faceBatches[i].clear();
+		appendShadowBatches(m_staticShadowCasters, faceFrusta, 1 << i, false, m_faceBatches[i]);
+		appendShadowBatches(m_dynamicShadowCasters, faceFrusta, 1 << i, false, m_faceBatches[i]);
+	}
+	uploadInstanceData();
+
+	useShadowProgram(m_shaderShadowMapMoments, m_uniformsShadowMapMoments);
+
+	// Texels without a caster hold the moments of the maximum distance
+	if (m_shadowFilter == SHADOW_FILTER_EVSM)
+	{
+		glClearColor(std::exp(40.f), std::exp(80.f), -std::exp(-5.f), std::exp(-10.f));
+	}
+	else
+	{
+		glClearColor(1.f, 1.f, 0.f, 0.f);
+	}
+
+	for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
+	{
+		m_shadowMap->setMomentCubeMapFace(face);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		renderShadowBatches(m_faceBatches[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X], faceViewProjections[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X]);
+	}
+	glClearColor(0, 0, 0, 1);
+
+	// The mip chain is the prefilter, the light pass reads a blurred level.
+	// The bind is elided if the map is still bound, so the unit is made 
+	// active separately.
+	m_stateCache.bindTexture(glUtil::MOMENT_SHADOW_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP, m_shadowMap->m_momentMap);
+	m_stateCache.setActiveTexture(glUtil::MOMENT_SHADOW_TEXTURE_UNIT);
+	m_shadowMap->generateMomentMipmaps();
+
+	m_stats.shadowFacesRendered += 6;
+	m_totals.shadowMapUpdates++;
+	m_totals.shadowFacesRendered += 6;
+}
+
+void Renderer::renderSoftwareShadowPass(
+	SceneGraph const& scene, 
+	LightSource const& light, 
+	float near
+)
+{
+	// Reuse the shadow map of the last frame if neither the light nor a caster has changed
+	if (m_shadowMapState.matches(light, scene.getCasterVersion(), near))
+	{
+		m_stats.shadowMapReused = true;
+		m_totals.shadowMapUpdatesSkipped++;
+		return;
+	}
+	m_shadowMapState = { true, &light, light.version, scene.getCasterVersion(), near };
+
+	// Same faces and bias as the GPU passes
+	glm::mat4 projection = m_shadowMap->getProjectionMatrix(near, light.radius);
+	std::array<glm::mat4, 6> faceViewProjections;
+	for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
+	{
+		faceViewProjections[face - GL_TEXTURE_CUBE_MAP_POSITIVE_X] = projection * m_shadowMap->getViewMatrix(face, light.position);
+	}
+
+	m_softwareShadowMap.init(m_shadowMap->m_size);
+	m_softwareShadowMap.clear();
+	for (std::vector<ShadowCaster> const* casters : { &m_staticShadowCasters, &m_dynamicShadowCasters })
+	{
+		for (ShadowCaster const& caster : *casters)
+		{
+			Mesh const& mesh = *caster.mesh;
+			m_softwareShadowMap.addMesh(&mesh.vertices[0].position, sizeof(Vertex), mesh.vertices.size(), mesh.indices, m_transforms[caster.transformIndex].modelMatrix);
+		}
+	}
+
+	if (m_shadowUsePolygonOffset)
+	{
+		m_softwareShadowMap.setPolygonOffset(m_shadowPolygonOffsetFactor, m_shadowPolygonOffsetUnits);
+	}
+	else
+	{
+		m_softwareShadowMap.setPolygonOffset(0.f, 0.f);
+	}
+	m_softwareShadowMap.setCullFace(m_shadowCullFront ? SoftwareShadowMap::CULL_FRONT : SoftwareShadowMap::CULL_BACK);
+
+	m_softwareShadowMap.render(faceViewProjections);
+
+	// Upload the window space depth of each face
+	m_stateCache.bindTexture(0, GL_TEXTURE_CUBE_MAP, m_shadowMap->m_cubeMap);
+	for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
+	{
+		std::vector<float> const& depth = m_softwareShadowMap.getFace(face - GL_TEXTURE_CUBE_MAP_POSITIVE_X);
+		glTexSubImage2D(face, 0, 0, 0, m_shadowMap->m_size, m_shadowMap->m_size, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+	}
+
+	m_stats.shadowFacesRendered += 6;
+	m_totals.shadowMapUpdates++;
+	m_totals.shadowFacesRendered += 6;
+}
+
+void Renderer::renderParameterizedShadowPass(
+	SceneGraph const& scene, 
+	LightSource const& light, 
+	float near
+)
+{
+	// Reuse the shadow map of the last frame if neither the light nor a caster has changed
+	if (m_shadowMapState.matches(light, scene.getCasterVersion(), near))
+	{
+		m_stats.shadowMapReused = true;
+		m_totals.shadowMapUpdatesSkipped++;
+		return;
+	}
+	m_shadowMapState = { true, &light, light.version, scene.getCasterVersion(), near };
+
+	m_stateCache.bindFramebuffer(m_shadowMap->m_framebuffer);
+	glViewport(0, 0, m_shadowMap->m_size, m_shadowMap->m_size);
+
+	if (m_shadowUsePolygonOffset)
+	{
+		m_stateCache.enablePolygonOffset(m_shadowPolygonOffsetFactor, m_shadowPolygonOffsetUnits);
+	}
+
+	if (m_shadowCullFront)
+	{
+		m_stateCache.setCullFace(GL_FRONT);
+	}
+	else
+	{
+		m_stateCache.setCullFace(GL_BACK);
+	}
+
+	m_instanceData.clear();
+	m_indirectCommands.clear();
+	for (size_t i = 0; i < 6; ++i)
+	{
+		m_faceBatches[i].clear();
+	}
+
+	uint32_t facesRendered = 0;
+	if (light.shadowMapType == SHADOW_MAP_DUAL_PARABOLOID)
+	{
+		// Casters are rendered into each hemisphere they reach into
+		for (std::vector<ShadowCaster> const* casters : { &m_staticShadowCasters, &m_dynamicShadowCasters })
+		{
+			for (ShadowCaster const& caster : *casters)
+			{
+				if (caster.bounds.max.z >= light.position.z)
+				{
+					appendInstance(m_faceBatches[0], caster, true);
+				}
+				if (caster.bounds.min.z <= light.position.z)
+				{
+					appendInstance(m_faceBatches[1], caster, true);
+				}
+			}
+		}
+		uploadInstanceData();
+
+		m_stateCache.useProgram(m_shaderShadowMapParaboloid.m_program);
+		glEnable(GL_CLIP_DISTANCE0);
+		for (GLint layer = 0; layer < 2; ++layer)
+		{
+			m_shadowMap->setParaboloidLayer(layer);
+			glClear(GL_DEPTH_BUFFER_BIT);
+
+			m_uniformShadowHemisphere.set(layer == 0 ? 1.f : -1.f);
+			m_stats.shadowDrawCalls += drawBatches(m_faceBatches[layer], 0, m_faceBatches[layer].size());
+			for (DrawBatch const& batch : m_faceBatches[layer])
+			{
+				m_stats.shadowInstances += batch.instanceCount;
+			}
+		}
+		glDisable(GL_CLIP_DISTANCE0);
+
+		facesRendered = 2;
+	}
+	else
+	{
+		// Four frusta, each rendered into one tile of the map
+		glm::mat4 projection = m_shadowMap->getTetrahedronProjectionMatrix(near, light.radius);
+		std::array<glm::mat4, 4> faceViewProjections;
+		std::vector<Frustum> faceFrusta;
+		for (int face = 0; face < 4; ++face)
+		{
+			faceViewProjections[face] = projection * m_shadowMap->getTetrahedronViewMatrix(face, light.position);
+			faceFrusta.emplace_back(faceViewProjections[face]);
+		}
+
+		for (int face = 0; face < 4; ++face)
+		{
+			appendShadowBatches(m_staticShadowCasters, faceFrusta, 1 << face, false, m_faceBatches[face]);
+			appendShadowBatches(m_dynamicShadowCasters, faceFrusta, 1 << face, false, m_faceBatches[face]);
+		}
+		uploadInstanceData();
+
+		useShadowProgram(m_shaderShadowMap, m_uniformsShadowMap);
+		m_shadowMap->setTetrahedralMap();
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		GLsizei tileSize = m_shadowMap->m_size / 2;
+		for (int face = 0; face < 4; ++face)
+		{
+			glViewport((face % 2) * tileSize, (face / 2) * tileSize, tileSize, tileSize);
+			renderShadowBatches(m_faceBatches[face], faceViewProjections[face]);
+		}
+
+		facesRendered = 4;
+	}
+
+	m_stateCache.disablePolygonOffset();
+
+	m_stats.shadowFacesRendered += facesRendered;
+	m_totals.shadowMapUpdates++;
+	m_totals.shadowFacesRendered += facesRendered;
+}
+
+void Renderer::appendShadowBatches(
+	std::vector<ShadowCaster> const& casters, 
+	std::vector<Frustum> const& faceFrusta, 
+	uint8_t faceMask,
+	bool onlyInShadowMap, 
+	std::vector<DrawBatch>& batches
+)
+{
+	for (ShadowCaster const& caster : casters)
+	{
+		if (onlyInShadowMap && !caster.inShadowMap)
+		{
+			continue;
+		}
+
+		// Only meshes inside the frustum of a face can affect its depth
+		bool inFaceFrustum = false;
+		for (size_t i = 0; i < faceFrusta.size() && !inFaceFrustum; ++i)
+		{
+			inFaceFrustum = (faceMask & (1 << i)) != 0 && faceFrusta[i].intersects(caster.bounds);
+		}
+		if (!inFaceFrustum)
+		{
+			m_stats.shadowCastersCulled++;
+			continue;
+		}
+
+		appendInstance(batches, caster, true);
+	}
+}
+
+void Renderer::appendInstance(std::vector<DrawBatch>& batches, MeshInstance const& instance, bool lightInRange)
+{
+	// The instance data of the last batch ends at the end of m_instanceData,
+	// so the instance can be appended to it
+	if (!batches.empty() && 
+		batches.back().mesh == instance.mesh && 
+		batches.back().lightInRange == lightInRange &&
+		batches.back().firstInstance + batches.back().instanceCount == m_instanceData.size())
+	{
+		batches.back().instanceCount++;
+		if (m_useMultiDrawIndirect)
+		{
+			m_indirectCommands[batches.back().command].instanceCount++;
+		}
+	}
+	else
+	{
+		uint32_t firstInstance = static_cast<uint32_t>(m_instanceData.size());
+		uint32_t command = static_cast<uint32_t>(m_indirectCommands.size());
+		batches.push_back({ instance.mesh, firstInstance, 1, command, lightInRange });
+
+		// Batches appended to the same list get consecutive commands
+		if (m_useMultiDrawIndirect)
+		{
+			GeometryArena::Range const& range = m_geometryArena.getRange(instance.mesh);
+			m_indirectCommands.push_back({ range.indexCount, 1, range.firstIndex, range.baseVertex, firstInstance });
+		}
+	}
+
+	// The baked visibility is fetched by gl_VertexID, which includes the base
+	// vertex of the geometry arena
+	uint32_t bakedOffset = ~0u;
+	uint32_t firstVertex = m_useBakedVisibility ? m_lightBaker.getFirstVertex(instance.id) : LightBaker::NO_VISIBILITY;
+	if (firstVertex != LightBaker::NO_VISIBILITY)
+	{
+		uint32_t baseVertex = m_useMultiDrawIndirect ? static_cast<uint32_t>(m_geometryArena.getRange(instance.mesh).baseVertex) : 0;
+		bakedOffset = LightBaker::TEXELS_PER_VERTEX * (firstVertex - baseVertex);
+	}
+
+	m_instanceData.push_back({ instance.transformIndex, instance.mesh->material.index, bakedOffset });
+}
+
+void Renderer::uploadInstanceData()
+{
+	// Orphan the old storage, draws of the previous pass may still read from it
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_instanceData.size() * sizeof(glUtil::DrawInstance), m_instanceData.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (m_useMultiDrawIndirect)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, m_indirectCommands.size() * sizeof(DrawElementsIndirectCommand), m_indirectCommands.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+void Renderer::updateGeometryArena(SceneGraph const& scene)
+{
+	if (!m_multiDrawIndirectSupported)
+	{
+		return;
+	}
+
+	bool changed = false;
+	for (SceneGraph::SceneNode const& node : scene.getNodes())
+	{
+		for (Mesh const* mesh : node.meshes)
+		{
+			if (!m_geometryArena.contains(mesh))
+			{
+				m_geometryArena.add(mesh);
+				changed = true;
+			}
+		}
+	}
+
+	if (changed)
+	{
+		m_geometryArena.upload(m_instanceBuffer);
+	}
+}
+
+void Renderer::drawBatch(DrawBatch const& batch)
+{
+	m_stateCache.bindVertexArray(batch.mesh->vertexArrayObject);
+
+	// Point the draw id attribute at the instance data of the batch
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glVertexAttribIPointer(
+		glUtil::DRAW_ID_ATTRIBUTE, 3, GL_UNSIGNED_INT, sizeof(glUtil::DrawInstance), 
+		reinterpret_cast<void const*>(batch.firstInstance * sizeof(glUtil::DrawInstance))
+	);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glDrawElementsInstanced(GL_TRIANGLES, batch.mesh->numIndices, GL_UNSIGNED_INT, 0, batch.instanceCount);
+}
+
+uint32_t Renderer::drawBatches(std::vector<DrawBatch> const& batches, size_t first, size_t count)
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	if (!m_useMultiDrawIndirect)
+	{
+		for (size_t i = first; i < first + count; ++i)
+		{
+			drawBatch(batches[i]);
+		}
+
+		return static_cast<uint32_t>(count);
+	}
+
+	// The commands of the batches are consecutive
+	m_stateCache.bindVertexArray(m_geometryArena.getVertexArrayObject());
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glMultiDrawElementsIndirect(
+		GL_TRIANGLES, GL_UNSIGNED_INT, 
+		reinterpret_cast<void const*>(batches[first].command * sizeof(DrawElementsIndirectCommand)),
+		static_cast<GLsizei>(count), 0
+	);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	return 1;
+}
+
+void Renderer::renderShadowBatches(std::vector<DrawBatch> const& batches, glm::mat4 const& viewProjection)
+{
+	m_shadowUniforms->viewProjection.set(viewProjection);
+
+	// All casters of a face share the same state
+	m_stats.shadowDrawCalls += drawBatches(batches, 0, batches.size());
+	for (DrawBatch const& batch : batches)
+	{
+		m_stats.shadowInstances += batch.instanceCount;
+	}
+}
+
+void Renderer::renderLayeredShadowBatches(
+	std::vector<DrawBatch> const& batches,
+	std::array<glm::mat4, 6> const& faceViewProjections,
+	uint8_t faceMask
+)
+{
+	m_shadowUniforms->faceViewProjections.set(faceViewProjections);
+	m_shadowUniforms->faceMask.set(faceMask);
+
+	m_stats.shadowDrawCalls += drawBatches(batches, 0, batches.size());
+	for (DrawBatch const& batch : batches)
+	{
+		m_stats.shadowInstances += batch.instanceCount;
+	}
+}
+
+void Renderer::renderPointLightShadows(
+	SceneGraph const& scene,
+	std::vector<LightSource> const& lights,
+	glm::mat4 const& viewMatrix,
+	Frustum const& cameraFrustum,
+	float vfov,
+	int height,
+	float near
+)
+{
+	size_t lightCount = std::min<size_t>(lights.size(), MAX_POINT_LIGHTS);
+	m_pointShadowSlots.assign(lightCount, { -1, 0, 0, false });
+	m_pointShadowStates.resize(lightCount);
+	m_stats.shadowAtlasBytesAllocated = m_shadowAllocator.getAllocatedBytes();
+	m_stats.pointShadowFaceBudget = m_pointShadowFaceBudget;
+
+	if (!m_usePointLights)
+	{
+		return;
+	}
+	m_stats.pointLights = static_cast<uint32_t>(lightCount);
+	m_stats.pointShadows.assign(lightCount, { -1, 0, 0, 0, 0.f });
+
+	if (!m_useShadowMap)
+	{
+		return;
+	}
+
+	// The importance of a light is the projected diameter of its sphere in
+	// pixels. Lights outside of the camera frustum get no shadow map.
+	glm::vec3 cameraPosition = glm::vec3(glm::inverse(viewMatrix)[3]);
+	float pixelsPerUnit = static_cast<float>(height) / (2.f * std::tan(vfov * 0.5f));
+	std::vector<ShadowAllocator::Request> requests;
+	for (uint32_t i = 0; i < lightCount; ++i)
+	{
+		LightSource const& light = lights[i];
+
+		// Baked lights need no shadow map
+		if (m_useBakedVisibility && m_lightBaker.isBaked(i, light))
+		{
+			m_stats.pointLightsBaked++;
+			continue;
+		}
+
+		BoundingBox lightBounds(light.position - glm::vec3(light.radius), light.position + glm::vec3(light.radius));
+		if (!cameraFrustum.intersects(lightBounds))
+		{
+			continue;
+		}
+
+		// A camera inside the sphere sees it at least as large as from its surface
+		float distance = std::max(glm::distance(cameraPosition, light.position), light.radius);
+		float diameter = 2.f * light.radius * pixelsPerUnit / distance;
+		requests.push_back({ i, diameter, static_cast<GLsizei>(diameter) });
+	}
+
+	std::vector<ShadowAllocator::Slot> slots;
+	m_shadowAllocator.allocate(requests, slots);
+	m_stats.shadowAtlasBytesUsed = m_shadowAllocator.getUsedBytes();
+
+	// An out of date face of a point light shadow map
+	struct FaceCandidate
+	{
+		uint32_t light;
+		GLint face;
+		bool invalid; // the face holds no depth of the light yet
+		float priority;
+	};
+
+	// Collect the faces of all shadow maps which are out of date
+	uint64_t frame = m_totals.frames;
+	std::vector<FaceCandidate> candidates;
+	for (size_t i = 0; i < requests.size(); ++i)
+	{
+		ShadowAllocator::Slot const& slot = slots[i];
+		if (slot.tier == -1)
+		{
+			continue;
+		}
+
+		uint32_t index = requests[i].light;
+		LightSource const& light = lights[index];
+		PointShadowState& state = m_pointShadowStates[index];
+		m_pointShadowSlots[index] = slot;
+
+		// The faces of a new slot hold the depth of another light
+		if (slot.isNew)
+		{
+			for (PointShadowFaceState& faceState : state.faces)
+			{
+				faceState.valid = false;
+			}
+		}
+
+		// Moving lights are updated before lights of the same size at rest
+		bool moving = light.version != state.seenLightVersion;
+		state.seenLightVersion = light.version;
+
+		// Only faces containing a changed caster are out of date. The set of
+		// casters within the radius also changes when the light moves.
+		if (moving || state.seenCasterVersion != scene.getCasterVersion())
+		{
+			state.seenCasterVersion = scene.getCasterVersion();
+			markDirtyPointShadowFaces(scene, light, near, state);
+		}
+		float priority = requests[i].importance * (moving ? POINT_SHADOW_MOVING_PRIORITY : 1.f);
+
+		for (GLint face = 0; face < 6; ++face)
+		{
+			PointShadowFaceState& faceState = state.faces[face];
+			bool upToDate =
+				faceState.valid &&
+				faceState.current &&
+				faceState.lightVersion == light.version &&
+				!faceState.casterDirty &&
+				faceState.near == near;
+			if (upToDate)
+			{
+				faceState.staleSince = 0;
+				continue;
+			}
+
+			if (faceState.staleSince == 0)
+			{
+				faceState.staleSince = frame;
+			}
+			candidates.push_back({ index, face, !faceState.valid, priority });
+		}
+	}
+
+	// Invalid faces come first and may use the whole budget. The faces of a 
+	// light stay together since they share its priority.
+	std::stable_sort(candidates.begin(), candidates.end(), [](FaceCandidate const& a, FaceCandidate const& b) {
+		return a.invalid != b.invalid ? a.invalid : a.priority > b.priority;
+	});
+
+	size_t budget = m_pointShadowFaceBudget;
+	size_t priorityBudget = budget - budget / 4;
+	std::vector<bool> selected(candidates.size(), false);
+	size_t selectedCount = 0;
+	for (size_t i = 0; i < candidates.size() && selectedCount < (candidates[i].invalid ? budget : priorityBudget); ++i)
+	{
+		selected[i] = true;
+		selectedCount++;
+	}
+
+	// The rest of the budget continues the round-robin over all faces where
+	// it stopped in the previous frame, so that no face stays out of date
+	size_t facePositions = lightCount * 6;
+	std::vector<int> candidateAt(facePositions, -1);
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		candidateAt[candidates[i].light * 6 + candidates[i].face] = static_cast<int>(i);
+	}
+	for (size_t step = 0; step < facePositions && selectedCount < budget; ++step)
+	{
+		size_t position = (m_pointShadowRoundRobin + step) % facePositions;
+		int candidate = candidateAt[position];
+		if (candidate == -1 || selected[candidate])
+		{
+			continue;
+		}
+
+		selected[candidate] = true;
+		selectedCount++;
+		m_pointShadowRoundRobin = (position + 1) % facePositions;
+	}
+
+	// Faces of the same light share the casters
+	std::vector<FaceCandidate> faces;
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		if (selected[i])
+		{
+			faces.push_back(candidates[i]);
+		}
+		else
+		{
+			m_stats.pointShadows[candidates[i].light].facesStale++;
+		}
+	}
+	std::sort(faces.begin(), faces.end(), [](FaceCandidate const& a, FaceCandidate const& b) {
+		return a.light != b.light ? a.light < b.light : a.face < b.face;
+	});
+	m_stats.pointShadowFacesDeferred = static_cast<uint32_t>(candidates.size() - faces.size());
+
+	m_instanceData.clear();
+	m_indirectCommands.clear();
+	m_pointShadowFaces.clear();
+	glm::mat4 projection;
+	std::vector<Frustum> faceFrusta;
+	for (size_t i = 0; i < faces.size(); ++i)
+	{
+		LightSource const& light = lights[faces[i].light];
+		ShadowAllocator::Slot const& slot = m_pointShadowSlots[faces[i].light];
+
+		if (i == 0 || faces[i].light != faces[i - 1].light)
+		{
+			// All shadow casting meshes within the light radius
+			m_pointShadowCasters.clear();
+			collectCastersInRadius(scene, light, m_pointShadowCasters, m_pointShadowCasters);
+			for (ShadowCaster& caster : m_pointShadowCasters)
+			{
+				caster.inShadowMap = true;
+			}
+			sortShadowCasters(m_pointShadowCasters, light);
+
+			projection = m_shadowMap->getProjectionMatrix(near, light.radius);
+			faceFrusta.clear();
+			for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face)
+			{
+				faceFrusta.emplace_back(projection * m_shadowMap->getViewMatrix(face, light.position));
+			}
+		}
+
+		GLint face = faces[i].face;
+		m_pointShadowFaces.push_back({
+			faces[i].light,
+			face,
+			m_shadowAllocator.getTexture(slot.tier),
+			6 * slot.layer + face,
+			slot.size,
+			projection * m_shadowMap->getViewMatrix(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, light.position),
+			{}
+		});
+		appendShadowBatches(m_pointShadowCasters, faceFrusta, 1 << face, false, m_pointShadowFaces.back().batches);
+	}
+
+	if (!m_pointShadowFaces.empty())
+	{
+		uploadInstanceData();
+
+		useShadowProgram(m_shaderShadowMap, m_uniformsShadowMap);
+		m_stateCache.bindFramebuffer(m_pointShadowFramebuffer);
+
+		if (m_shadowUsePolygonOffset)
+		{
+			m_stateCache.enablePolygonOffset(m_shadowPolygonOffsetFactor, m_shadowPolygonOffsetUnits);
+		}
+
+		if (m_shadowCullFront)
+		{
+			m_stateCache.setCullFace(GL_FRONT);
+		}
+		else
+		{
+			m_stateCache.setCullFace(GL_BACK);
+		}
+
+		for (PointShadowFace const& face : m_pointShadowFaces)
+		{
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, face.texture, 0, face.layer);
+			glViewport(0, 0, face.size, face.size);
+			glClear(GL_DEPTH_BUFFER_BIT);
+
+			renderShadowBatches(face.batches, face.viewProjection);
+
+			LightSource const& light = lights[face.light];
+			m_pointShadowStates[face.light].faces[face.face] = { true, true, light.version, false, near, 0 };
+			m_stats.pointShadows[face.light].facesUpdated++;
+		}
+
+		m_stateCache.disablePolygonOffset();
+
+		m_stats.pointShadowFacesRendered = static_cast<uint32_t>(m_pointShadowFaces.size());
+		m_totals.pointShadowFacesRendered += m_pointShadowFaces.size();
+	}
+
+	// Lights whose shadow map is incomplete are lit without shadow
+	for (uint32_t i = 0; i < lightCount; ++i)
+	{
+		PointShadowState& state = m_pointShadowStates[i];
+		PointShadowStats& stats = m_stats.pointShadows[i];
+		state.updateRate = 0.95f * state.updateRate + 0.05f * static_cast<float>(stats.facesUpdated);
+		stats.updateRate = state.updateRate;
+
+		if (m_pointShadowSlots[i].tier == -1)
+		{
+			continue;
+		}
+
+		bool complete = true;
+		for (PointShadowFaceState const& faceState : state.faces)
+		{
+			complete = complete && faceState.valid;
+			if (faceState.staleSince != 0)
+			{
+				stats.staleness = std::max(stats.staleness, frame - faceState.staleSince);
+			}
+		}
+
+		if (complete)
+		{
+			stats.tier = m_pointShadowSlots[i].tier;
+			m_stats.pointLightsShadowed++;
+		}
+		else
+		{
+			m_pointShadowSlots[i].tier = -1;
+		}
+	}
+}
+
+void Renderer::bakeLighting(SceneGraph const& scene, std::vector<LightSource> const& lights)
+{
+	if (lights.empty())
+	{
+		return;
+	}
+
+	m_lightBaker.bake(scene, lights);
+
+	std::vector<uint8_t> const& visibility = m_lightBaker.getVisibility();
+	glBindBuffer(GL_TEXTURE_BUFFER, m_bakedVisibilityBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, visibility.size(), visibility.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// The variant only fetches and interpolates the texels of the baked lights
+	size_t bakedTexels = (std::min<size_t>(lights.size(), LightBaker::MAX_LIGHTS) + 3) / 4;
+	m_shaderDefaultBaked.initVariant("assets/shader/default.vert.glsl", "assets/shader/default.frag.glsl", 
+		"#define BAKED_TEXELS " + std::to_string(bakedTexels) + "\n");
+	m_uniformsDefaultBaked.init(m_shaderDefaultBaked);
+	setProgramBindings(m_shaderDefaultBaked);
+	glUseProgram(0);
+}
+
+void Renderer::updatePointLightUniforms(
+	std::vector<LightSource> const& lights,
+	glm::mat4 const& viewMatrix,
+	float near
+)
+{
+	PointLightBlock block = {};
+	block.count = m_usePointLights ? static_cast<GLint>(m_pointShadowSlots.size()) : 0;
+	block.shadowNear = near;
+	for (GLint i = 0; i < block.count; ++i)
+	{
+		LightSource const& light = lights[i];
+		ShadowAllocator::Slot const& slot = m_pointShadowSlots[i];
+
+		PointLightUniforms& uniforms = block.lights[i];
+		uniforms.positionRadius = glm::vec4(glm::vec3(viewMatrix * glm::vec4(light.position, 1.f)), light.radius);
+		uniforms.positionWorld = glm::vec4(light.position, 1.f);
+		uniforms.Id = light.Id;
+		uniforms.Is = light.Is;
+		bool baked = m_useBakedVisibility && m_lightBaker.isBaked(i, light);
+		uniforms.shadowMap = glm::ivec4(slot.tier, slot.layer, baked ? 1 : 0, 0);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_pointLightUniformBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PointLightBlock), &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Renderer::renderLightPass(
+	LightSource const& light, 
+	int width,
+	int height
+)
+{
+	m_stateCache.bindFramebuffer(0);
+	glViewport(0, 0, width, height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	
+	// Set GL state
+	m_stateCache.setCullFace(GL_BACK);
+	glEnable(GL_MULTISAMPLE);
+
+	// Load program
+	glUtil::ShaderProgram const& currentShader = getLightPassProgram();
+	LightPassUniforms const& uniforms = getLightPassUniforms();
+	m_stateCache.useProgram(currentShader.m_program);
+
+	if (m_useShadowMap)
+	{
+		// Shadow map texture matching the type of the light
+		switch (light.shadowMapType)
+		{
+		default:
+		case SHADOW_MAP_CUBE:
+			if (m_shadowFilter != SHADOW_FILTER_COMPARE)
+			{
+				m_stateCache.bindTexture(glUtil::MOMENT_SHADOW_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP, m_shadowMap->m_momentMap);
+			}
+			else
+			{
+				m_stateCache.bindTexture(0, GL_TEXTURE_CUBE_MAP, m_shadowMap->m_cubeMap);
+			}
+			break;
+
+		case SHADOW_MAP_DUAL_PARABOLOID:
+			m_stateCache.bindTexture(glUtil::PARABOLOID_SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, m_shadowMap->m_paraboloidMap);
+			break;
+
+		case SHADOW_MAP_TETRAHEDRAL:
+			m_stateCache.bindTexture(glUtil::TETRAHEDRAL_SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D, m_shadowMap->m_tetrahedralMap);
+			break;
+		}
+
+		// Point light shadow maps, one cube map array per tier
+		if (m_usePointLights)
+		{
+			for (size_t tier = 0; tier < m_shadowAllocator.getTierCount(); ++tier)
+			{
+				m_stateCache.bindTexture(glUtil::POINT_SHADOW_TEXTURE_UNIT + static_cast<GLuint>(tier), GL_TEXTURE_CUBE_MAP_ARRAY, m_shadowAllocator.getTexture(static_cast<int>(tier)));
+			}
+		}
+	}
+
+	// Camera and light parameters are read from the frame uniform buffer
+
+	// Only meshes within the camera frustum are rendered. Sorting placed
+	// instances of the same mesh next to each other.
+	m_instanceData.clear();
+	m_indirectCommands.clear();
+	m_lightBatches.clear();
+	for (MeshInstance const& instance : m_visibleMeshes)
+	{
+		// Meshes outside of the light radius skip lighting and the shadow lookup
+		bool lightInRange = instance.bounds.intersectsSphere(light.position, light.radius);
+		if (!lightInRange)
+		{
+			m_stats.lightMeshesOutsideRadius++;
+		}
+
+		appendInstance(m_lightBatches, instance, lightInRange);
+	}
+	uploadInstanceData();
+
+	size_t first = 0;
+	while (first < m_lightBatches.size())
+	{
+		DrawBatch const& batch = m_lightBatches[first];
+		Material const& material = batch.mesh->material;
+		uint16_t bindState = m_materialBindStates[material.index];
+
+		// Consecutive batches with the same texture arrays and light range 
+		// share all state and can be drawn together. The material parameters 
+		// and texture layers are read per instance from the material buffer.
+		size_t count = 1;
+		while (first + count < m_lightBatches.size() &&
+			m_materialBindStates[m_lightBatches[first + count].mesh->material.index] == bindState &&
+			m_lightBatches[first + count].lightInRange == batch.lightInRange)
+		{
+			count++;
+		}
+
+		uniforms.lightInRange.set(batch.lightInRange);
+
+		// Material textures
+		m_stateCache.bindTexture(1, GL_TEXTURE_2D_ARRAY, material.textureKa.texture);
+		m_stateCache.bindTexture(2, GL_TEXTURE_2D_ARRAY, material.textureKd.texture);
+		m_stateCache.bindTexture(3, GL_TEXTURE_2D_ARRAY, material.textureKs.texture);
+
+		// Draw all instances of the meshes
+		m_stats.lightDrawCalls += drawBatches(m_lightBatches, first, count);
+		for (size_t i = first; i < first + count; ++i)
+		{
+			m_stats.lightInstances += m_lightBatches[i].instanceCount;
+		}
+
+		first += count;
+	}
+
+	glDisable(GL_MULTISAMPLE);
+}
+
+RenderStats const& Renderer::getStats() const
+{
+	return m_stats;
+}
+
+RenderTotals const& Renderer::getTotals() const
+{
+	return m_totals;
+}
+
+void Renderer::printStats() const
+{
+	SPDLOG_DEBUG("Render statistics (last frame):");
+	SPDLOG_DEBUG("  Shadow pass draw calls:  {}", m_stats.shadowDrawCalls);
+	SPDLOG_DEBUG("  Shadow pass instances:   {}", m_stats.shadowInstances);
+	SPDLOG_DEBUG("  Shadow casters culled:   {}", m_stats.shadowCastersCulled);
+	SPDLOG_DEBUG("  Casters outside radius:  {}", m_stats.shadowCastersOutsideRadius);
+	SPDLOG_DEBUG("  Casters w/o receiver:    {}", m_stats.shadowCastersWithoutReceiver);
+	SPDLOG_DEBUG("  Shadow faces rendered:   {}", m_stats.shadowFacesRendered);
+	SPDLOG_DEBUG("  Faces w/o receiver:      {}", m_stats.shadowFacesSkipped);
+	SPDLOG_DEBUG("  Light pass draw calls:   {}", m_stats.lightDrawCalls);
+	SPDLOG_DEBUG("  Light pass instances:    {}", m_stats.lightInstances);
+	SPDLOG_DEBUG("  Meshes outside frustum:  {}", m_stats.lightMeshesCulled);
+	SPDLOG_DEBUG("  Meshes outside radius:   {}", m_stats.lightMeshesOutsideRadius);
+	SPDLOG_DEBUG("  State changes issued:    {}", m_stats.stateChangesIssued);
+	SPDLOG_DEBUG("  State changes elided:    {}", m_stats.stateChangesElided);
+	SPDLOG_DEBUG("  Shadow map size:         {} (desired {:.0f})", m_stats.shadowMapSize, m_stats.shadowMapDesiredSize);
+	SPDLOG_DEBUG("  Shadow map reused:       {}", m_stats.shadowMapReused);
+	SPDLOG_DEBUG("  Static casters updated:  {}", m_stats.staticShadowMapUpdated);
+	SPDLOG_DEBUG("  Point lights:            {}", m_stats.pointLights);
+	SPDLOG_DEBUG("  Point lights shadowed:   {}", m_stats.pointLightsShadowed);
+	SPDLOG_DEBUG("  Point lights baked:      {}", m_stats.pointLightsBaked);
+	SPDLOG_DEBUG("  Point faces rendered:    {} (budget {})", m_stats.pointShadowFacesRendered, m_stats.pointShadowFaceBudget);
+	SPDLOG_DEBUG("  Point faces deferred:    {}", m_stats.pointShadowFacesDeferred);
+	SPDLOG_DEBUG("  Shadow atlas memory:     {} / {} MiB", m_stats.shadowAtlasBytesUsed >> 20, m_stats.shadowAtlasBytesAllocated >> 20);
+	for (size_t i = 0; i < m_stats.pointShadows.size(); ++i)
+	{
+		PointShadowStats const& light = m_stats.pointShadows[i];
+		SPDLOG_DEBUG(
+			"    Point light {:2}: tier {:2}, {} faces updated, {} stale, staleness {} frames, {:.2f} faces/frame",
+			i, light.tier, light.facesUpdated, light.facesStale, light.staleness, light.updateRate
+		);
+	}
+	SPDLOG_DEBUG("Render statistics (total):");
+	SPDLOG_DEBUG("  Frames:                  {}", m_totals.frames);
+	SPDLOG_DEBUG("  Shadow map updates:      {}", m_totals.shadowMapUpdates);
+	SPDLOG_DEBUG("  Shadow faces rendered:   {}", m_totals.shadowFacesRendered);
+	SPDLOG_DEBUG("  Shadow updates skipped:  {}", m_totals.shadowMapUpdatesSkipped);
+	SPDLOG_DEBUG("  Static caster updates:   {}", m_totals.staticShadowMapUpdates);
+	SPDLOG_DEBUG("  Shadow map resizes:      {}", m_totals.shadowMapResizes);
+	SPDLOG_DEBUG("  Point faces rendered:    {}", m_totals.pointShadowFacesRendered);
 }
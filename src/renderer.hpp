@@ -2,10 +2,129 @@
 
 #include "input.hpp"
 #include "glUtil.hpp"
+#include "frustum.hpp"
+#include "renderQueue.hpp"
+#include "geometryArena.hpp"
+#include "shadowAllocator.hpp"
+#include "softwareShadowMap.hpp"
+#include "lightBaker.hpp"
 
 #include "scene/sceneGraph.hpp"
 #include "scene/lightSource.hpp"
 
+#include <unordered_map>
+
+
+// Filtering of the cube shadow map. The values are used by the shaders.
+enum ShadowFilter
+{
+	SHADOW_FILTER_COMPARE = 0, // hardware depth comparison of the depth cube map
+	SHADOW_FILTER_VSM = 1, // variance shadow map, prefiltered by mipmapping
+	SHADOW_FILTER_EVSM = 2, // exponential variance shadow map, prefiltered by mipmapping
+};
+
+// Shadow map updates of a point light
+struct PointShadowStats
+{
+	int tier; // -1 if the light has no complete shadow map
+	uint32_t facesUpdated; // faces rendered in the last frame
+	uint32_t facesStale; // faces which are still out of date
+	uint64_t staleness; // frames since the oldest out of date face was up to date
+	float updateRate; // average number of faces rendered per frame
+};
+
+// Counters describing the work done while rendering the last frame
+struct RenderStats
+{
+	uint32_t shadowDrawCalls; // draw calls issued during the shadow pass
+	uint32_t shadowInstances; // meshes drawn by the instanced shadow pass draw calls
+	uint32_t shadowCastersCulled; // caster/face pairs rejected by frustum culling
+	uint32_t shadowCastersOutsideRadius; // casters outside of the light radius
+	uint32_t shadowCastersWithoutReceiver; // casters whose shadow cannot reach a visible mesh
+	uint32_t shadowFacesRendered; // cube map faces re-rendered
+	uint32_t shadowFacesSkipped; // dirty cube map faces skipped because they have no visible receiver
+	uint32_t lightDrawCalls; // draw calls issued during the light pass
+	uint32_t lightInstances; // meshes drawn by the instanced light pass draw calls
+	uint32_t lightMeshesCulled; // meshes outside of the camera frustum
+	uint32_t lightMeshesOutsideRadius; // meshes rendered without lighting and shadow lookup
+	uint32_t stateChangesIssued; // state changing GL calls passed on by the state cache
+	uint32_t stateChangesElided; // redundant state changing GL calls dropped by the state cache
+	GLsizei shadowMapSize; // size of the cube shadow map in use
+	float shadowMapDesiredSize; // size estimated from the texel density, 0 if not estimated
+	bool shadowMapReused; // true if the shadow map of the previous frame was reused
+	bool staticShadowMapUpdated; // true if the cached static casters were re-rendered
+	uint32_t pointLights; // additional point lights passed to the light pass
+	uint32_t pointLightsShadowed; // point lights which got a shadow map
+	uint32_t pointLightsBaked; // point lights whose visibility is read from the baked vertices
+	uint32_t pointShadowFacesRendered; // cube map faces of point light shadow maps re-rendered
+	uint32_t pointShadowFacesDeferred; // out of date point light faces left for later frames
+	uint32_t pointShadowFaceBudget; // point light faces which may be rendered per frame
+	size_t shadowAtlasBytesUsed; // memory of the point light shadow maps in use
+	size_t shadowAtlasBytesAllocated; // memory of all point light shadow map tiers
+	std::vector<PointShadowStats> pointShadows; // by point light
+};
+
+// Counters accumulated over all rendered frames
+struct RenderTotals
+{
+	uint64_t frames; // number of rendered frames
+	uint64_t shadowMapUpdates; // number of frames in which the shadow map was rendered
+	uint64_t shadowFacesRendered; // number of rendered cube map faces
+	uint64_t shadowMapUpdatesSkipped; // number of frames in which the shadow map was reused
+	uint64_t staticShadowMapUpdates; // number of frames in which the static casters were re-rendered
+	uint64_t shadowMapResizes; // number of switches to a shadow map of another size
+	uint64_t pointShadowFacesRendered; // number of rendered point light cube map faces
+};
+
+// Per-frame parameters as laid out in the std140 uniform block FrameBlock of
+// assets/shader/frameBlock.glsl
+struct FrameUniforms
+{
+	glm::mat4 projectionMatrix;
+	glm::mat4 viewMatrix;
+	glm::mat4 shadowMapProjection;
+	glm::vec3 lightPosition; // eye space
+	float lightRadius;
+	glm::vec3 lightPositionWorld;
+	float padding;
+	glm::vec4 Ia;
+	glm::vec4 Id;
+	glm::vec4 Is;
+	glm::mat4 tetrahedronViewProjections[4]; // light space
+	GLint shadowMapType;
+	float shadowNear;
+	GLint shadowLinearDepth; // std140 bool
+	GLint shadowFilter;
+};
+
+// Maximum number of additional point lights, must match the shaders
+uint32_t const MAX_POINT_LIGHTS = 32;
+
+// Parameters of an additional point light as laid out in PointLightBlock
+struct PointLightUniforms
+{
+	glm::vec4 positionRadius; // eye space position, influence radius
+	glm::vec4 positionWorld;
+	glm::vec4 Id;
+	glm::vec4 Is;
+	glm::ivec4 shadowMap; // tier (-1 without shadow map), cube map layer, 1 if the visibility is baked
+};
+
+// Additional point lights as laid out in the std140 uniform block PointLightBlock
+struct PointLightBlock
+{
+	PointLightUniforms lights[MAX_POINT_LIGHTS];
+	GLint count;
+	float shadowNear;
+	float padding[2];
+};
+
+// Transform of a scene node as laid out in the transform buffer
+struct NodeTransform
+{
+	glm::mat4 modelMatrix; // model space -> world space
+	glm::mat4 normalMatrix; // model space normal -> world space normal
+};
 
 class Renderer
 {
@@ -18,45 +137,464 @@ public:
 	void render(
 		SceneGraph const& scene, 
 		LightSource const& light, 
+		std::vector<LightSource> const& pointLights,
 		glm::mat4 viewMatrix, 
 		float vfov,
 		int width, 
 		int height,
 		float near, 
 		float far
-	) const;
+	);
+
+	// Bakes the visibility of the point lights into the static meshes and 
+	// compiles the light pass variant which reads it. The bake is used while
+	// the static nodes stay unchanged. Lights which moved since fall back to
+	// their shadow map.
+	void bakeLighting(SceneGraph const& scene, std::vector<LightSource> const& lights);
+
+	RenderStats const& getStats() const;
+	RenderTotals const& getTotals() const;
 
 private:
+	// A mesh attached to a scene node
+	struct MeshInstance
+	{
+		Mesh const* mesh;
+		uint32_t transformIndex; // index of the node transform in the transform buffer
+		BoundingBox bounds; // world space bounds
+		uint64_t id; // identifies the node and the mesh within the node
+	};
+
+	// A mesh which is rendered into the shadow map
+	struct ShadowCaster : MeshInstance
+	{
+		bool reachesVisibleReceiver; // false if its shadow cannot fall onto a visible mesh
+		bool inShadowMap; // rendered into the shadow map, either required or still up to date
+	};
+
+	// State a shadow map was rendered with. Used to skip rendering if 
+	// neither the light nor the shadow casters have changed.
+	struct ShadowMapState
+	{
+		bool valid; // false if the shadow settings changed
+		LightSource const* light;
+		uint64_t lightVersion;
+		uint64_t casterVersion;
+		float near;
+
+		// Returns true if the shadow map is still up to date
+		bool matches(LightSource const& otherLight, uint64_t otherCasterVersion, float otherNear) const;
+
+		// Returns true if the shadow map was rendered for the same light 
+		// regardless of changed casters
+		bool matchesLight(LightSource const& otherLight, float otherNear) const;
+	};
+
+	// Instances of a mesh drawn with a single instanced draw call. The 
+	// transform indices are stored consecutively in the instance data.
+	struct DrawBatch
+	{
+		Mesh const* mesh;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+		uint32_t command; // index of the indirect command drawing the batch
+		bool lightInRange; // only used in the light pass
+	};
+
+	// A cube map face of a point light shadow map to be rendered
+	struct PointShadowFace
+	{
+		uint32_t light;
+		GLint face;
+		GLuint texture; // cube map array of the tier
+		GLint layer; // 6 * cube map layer + face
+		GLsizei size;
+		glm::mat4 viewProjection;
+		std::vector<DrawBatch> batches;
+	};
+
+	// State a face of a point light shadow map was rendered with
+	struct PointShadowFaceState
+	{
+		bool valid; // false if the face holds the depth of another light
+		bool current; // false if the shadow settings changed
+		uint64_t lightVersion;
+		bool casterDirty; // a caster within the face changed since it was rendered
+		float near;
+		uint64_t staleSince; // frame in which the face became out of date, 0 if up to date
+	};
+
+	// Update state of the shadow map of a point light
+	struct PointShadowState
+	{
+		std::array<PointShadowFaceState, 6> faces;
+		uint64_t seenLightVersion; // light version of the previous frame
+		uint64_t seenCasterVersion; // caster version the caster bounds were compared at
+		std::unordered_map<uint64_t, BoundingBox> casterBounds; // bounds of the casters within the radius
+		float updateRate; // average number of faces rendered per frame
+	};
+
+	// Layout of the commands read by glMultiDrawElementsIndirect
+	struct DrawElementsIndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// Pass field of the render queue keys
+	enum RenderPass : uint32_t
+	{
+		SHADOW_PASS = 0,
+		LIGHT_PASS = 1,
+	};
+
+	// Uniforms of the programs used in the light pass
+	struct LightPassUniforms
+	{
+		// Resolves the handles of the program
+		void init(glUtil::ShaderProgram const& program);
+
+		glUtil::Uniform<bool> lightInRange;
+	};
+
+	// Uniforms of the programs used to render cube map faces
+	struct ShadowPassUniforms
+	{
+		// Resolves the handles of the program
+		void init(glUtil::ShaderProgram const& program);
+
+		glUtil::Uniform<glm::mat4> viewProjection;
+		glUtil::Uniform<std::array<glm::mat4, 6>> faceViewProjections;
+		glUtil::Uniform<int> faceMask;
+		glUtil::Uniform<glm::vec2> depthOffset; // polygon offset of the linear depth programs
+	};
+
+	// Assigns the texture units of the samplers and the uniform block 
+	// bindings, which never change
+	void setProgramBindings(glUtil::ShaderProgram const& program);
+
+	// Program of the light pass matching the shadow settings and its uniforms
+	glUtil::ShaderProgram const& getLightPassProgram() const;
+	LightPassUniforms const& getLightPassUniforms() const;
+
+	// Forces all shadow maps to be re-rendered
+	void invalidateShadowMaps();
+
+	// Switches to the shadow map of the pool with the given size
+	void setShadowMapSize(GLsizei size);
+
+	// Creates the shadow maps of the pool next to the one in use and 
+	// releases all others
+	void updateShadowMapPool();
+
+	// Switches all cube shadow maps of the pool between the default depth 
+	// format and 16 bit normalized linear distance to the light
+	void setShadowLinearDepth(bool linearDepth);
+
+	// Changes the offset units of the current depth format by the given 
+	// number of steps and logs them
+	void changeShadowOffsetUnits(float steps);
+
+	// Uses the program for the following shadow batches
+	void useShadowProgram(glUtil::ShaderProgram const& program, ShadowPassUniforms const& uniforms);
+
+	// Estimates the cube map size at which a shadow map texel covers about
+	// one pixel at the edge of the visible lit region and switches to it 
+	// once the estimate has left the current size for a number of frames
+	void updateShadowMapSize(LightSource const& light, glm::mat4 const& viewMatrix, float vfov, int height);
+
+	// Collects all meshes within the camera frustum and the bounds of the
+	// visible meshes which can receive light i.e. shadows
+	void collectVisibleMeshes(SceneGraph const& scene, LightSource const& light, Frustum const& cameraFrustum);
+
+	// Appends the shadow casting meshes within the radius of the light to the
+	// static or dynamic casters, which may be the same vector. Returns the
+	// number of casters outside of the radius.
+	static uint32_t collectCastersInRadius(SceneGraph const& scene, LightSource const& light, std::vector<ShadowCaster>& staticCasters, std::vector<ShadowCaster>& dynamicCasters);
+
+	// Collects all shadow casting meshes within the radius of the light and
+	// checks whether their shadow can reach a visible receiver
+	void collectShadowCasters(SceneGraph const& scene, LightSource const& light, Frustum const& cameraFrustum);
+
+	// Orders the visible meshes by state and front to back using the render queue
+	void sortVisibleMeshes(glm::mat4 const& viewMatrix, float far);
+
+	// Orders the casters by vertex array and by distance to the light
+	void sortShadowCasters(std::vector<ShadowCaster>& casters, LightSource const& light);
+
+	// Returns the bounds of the region the caster can cast a shadow onto
+	static BoundingBox getShadowVolumeBounds(BoundingBox const& casterBounds, LightSource const& light);
+
+	// Returns true if the frustum of the face contains a visible receiver
+	bool hasVisibleReceivers(Frustum const& faceFrustum) const;
+
+	// Compares the casters with the ones stored in the shadow map and marks
+	// the faces containing the old or new bounds of changed casters as dirty.
+	// Sets inShadowMap of the casters and updates m_shadowMapCasterBounds.
+	void markDirtyShadowMapFaces(
+		std::vector<ShadowCaster>& casters,
+		std::unordered_map<uint64_t, BoundingBox>& previousCasterBounds,
+		std::vector<Frustum> const& faceFrusta
+	);
+
+	// Marks all faces whose frustum intersects the bounds as dirty
+	void markDirtyShadowMapFaces(BoundingBox const& bounds, std::vector<Frustum> const& faceFrusta);
+
+	// Compares the casters within the radius of the point light with the 
+	// ones of the previous check and marks the faces of its shadow map 
+	// containing the old or new bounds of changed casters as dirty
+	void markDirtyPointShadowFaces(SceneGraph const& scene, LightSource const& light, float near, PointShadowState& state);
+
 	void renderShadowPass(
 		SceneGraph const& scene,
 		LightSource const& light,
-		float near,
-		float far
-	) const;
+		Frustum const& cameraFrustum,
+		float near
+	);
 
-	void renderLightPass(
+	// Renders the distance moments of all casters into the moment cube map
+	// of the shadow map and prefilters it by generating its mipmaps
+	void renderMomentShadowPass(
 		SceneGraph const& scene,
 		LightSource const& light,
-		glm::mat4 viewMatrix,
+		float near
+	);
+
+	// Renders all casters into the cube shadow map on the CPU and uploads 
+	// the faces. Used whenever the light or a caster has changed.
+	void renderSoftwareShadowPass(
+		SceneGraph const& scene,
+		LightSource const& light,
+		float near
+	);
+
+	// Renders the dual paraboloid or tetrahedral shadow map of the light. 
+	// All casters are rendered whenever the light or a caster has changed.
+	void renderParameterizedShadowPass(
+		SceneGraph const& scene,
+		LightSource const& light,
+		float near
+	);
+
+	// Appends batches of the casters within the frustum of at least one of 
+	// the faces in faceMask (bit i selects faceFrusta[i]). Consecutive 
+	// casters sharing a mesh are merged into one batch. Casters which are not
+	// part of the shadow map are skipped if onlyInShadowMap is set.
+	void appendShadowBatches(
+		std::vector<ShadowCaster> const& casters,
+		std::vector<Frustum> const& faceFrusta,
+		uint8_t faceMask,
+		bool onlyInShadowMap,
+		std::vector<DrawBatch>& batches
+	);
+
+	// Appends a batch or extends the last one if it draws the same mesh
+	void appendInstance(std::vector<DrawBatch>& batches, MeshInstance const& instance, bool lightInRange);
+
+	// Uploads the instance data and indirect commands of all batches 
+	// collected since the last upload
+	void uploadInstanceData();
+
+	// Adds meshes which are not yet part of the geometry arena
+	void updateGeometryArena(SceneGraph const& scene);
+
+	// Issues an instanced draw call for the batch
+	void drawBatch(DrawBatch const& batch);
+
+	// Draws consecutive batches which share all state. Uses a single multi 
+	// draw call if available, otherwise one draw call per batch. Returns the
+	// number of draw calls.
+	uint32_t drawBatches(std::vector<DrawBatch> const& batches, size_t first, size_t count);
+
+	// Renders the batches into the currently attached cube map face
+	void renderShadowBatches(std::vector<DrawBatch> const& batches, glm::mat4 const& viewProjection);
+
+	// Renders the batches into all faces in faceMask of the cube map which 
+	// is attached as layered texture. The geometry shader routes each 
+	// triangle to the faces it covers.
+	void renderLayeredShadowBatches(
+		std::vector<DrawBatch> const& batches,
+		std::array<glm::mat4, 6> const& faceViewProjections,
+		uint8_t faceMask
+	);
+
+	// Writes the camera and light parameters into the frame uniform buffer
+	void updateFrameUniforms(
+		LightSource const& light,
+		glm::mat4 const& viewMatrix,
+		glm::mat4 const& projectionMatrix,
+		float near
+	);
+
+	// Writes the transforms of all nodes into the transform buffer
+	void updateTransforms(SceneGraph const& scene);
+
+	// Writes the parameters of all materials into the material buffer and 
+	// assigns a bind state to each material. Only does work if materials 
+	// have been added since the last call.
+	void updateMaterials(SceneGraph const& scene);
+
+	// Assigns shadow maps from the shadow allocator to the point lights 
+	// within the camera frustum by their projected size. Out of date faces 
+	// are re-rendered within the per-frame face budget: faces without valid
+	// depth first, then by the projected size of the light with a boost for 
+	// moving lights, the rest of the budget round-robin over all faces. A 
+	// light is only shadowed once all of its faces are valid.
+	void renderPointLightShadows(
+		SceneGraph const& scene,
+		std::vector<LightSource> const& lights,
+		glm::mat4 const& viewMatrix,
+		Frustum const& cameraFrustum,
 		float vfov,
-		int width,
 		int height,
-		float near,
-		float far
-	) const;
+		float near
+	);
+
+	// Writes the point lights and their shadow map slots into the point 
+	// light uniform buffer
+	void updatePointLightUniforms(
+		std::vector<LightSource> const& lights,
+		glm::mat4 const& viewMatrix,
+		float near
+	);
+
+	void renderLightPass(
+		LightSource const& light,
+		int width,
+		int height
+	);
+
+	void printStats() const;
 
 
 private:
-	GLuint m_shaderDefault;
-	GLuint m_shaderDefaultNoShadow;
-	GLuint m_shaderShadowMap;
+	glUtil::ShaderProgram m_shaderDefault;
+	glUtil::ShaderProgram m_shaderDefaultNoShadow;
+	glUtil::ShaderProgram m_shaderDefaultBaked; // variant reading the baked visibility, compiled by bakeLighting()
+	glUtil::ShaderProgram m_shaderShadowMap;
+	glUtil::ShaderProgram m_shaderShadowMapLayered;
+	glUtil::ShaderProgram m_shaderShadowMapLinear;
+	glUtil::ShaderProgram m_shaderShadowMapLayeredLinear;
+	glUtil::ShaderProgram m_shaderShadowMapParaboloid;
+	glUtil::ShaderProgram m_shaderShadowMapMoments;
+
+	LightPassUniforms m_uniformsDefault;
+	LightPassUniforms m_uniformsDefaultNoShadow;
+	LightPassUniforms m_uniformsDefaultBaked;
+	ShadowPassUniforms m_uniformsShadowMap;
+	ShadowPassUniforms m_uniformsShadowMapLayered;
+	ShadowPassUniforms m_uniformsShadowMapLinear;
+	ShadowPassUniforms m_uniformsShadowMapLayeredLinear;
+	ShadowPassUniforms m_uniformsShadowMapMoments;
+	ShadowPassUniforms const* m_shadowUniforms; // uniforms of the shadow program in use
+	glUtil::Uniform<float> m_uniformShadowHemisphere;
+
+	GLuint m_frameUniformBuffer; // std140 FrameBlock, written once per frame
+	GLuint m_pointLightUniformBuffer; // std140 PointLightBlock, written once per frame
+
+	// Node transforms of the current frame, indexed by the draw id
+	GLuint m_transformBuffer;
+	GLuint m_transformTexture; // texture buffer view of m_transformBuffer
+	std::vector<NodeTransform> m_transforms;
+
+	// Parameters of all materials, indexed by the material index
+	GLuint m_materialBuffer;
+	GLuint m_materialTexture; // texture buffer view of m_materialBuffer
+	size_t m_materialCount; // number of materials in m_materialBuffer
+
+	// Materials whose textures are in the same texture arrays share a bind 
+	// state and can be drawn together
+	std::vector<uint16_t> m_materialBindStates;
+
+	glUtil::StateCache m_stateCache;
 
-	glUtil::ShadowMap m_shadowMap;
+	// Cube shadow maps of all sizes from SHADOW_MAP_MIN_SIZE to 
+	// SHADOW_MAP_MAX_SIZE. m_shadowMap points at the one in use. Only it and
+	// the next smaller and larger size are allocated.
+	std::array<glUtil::ShadowMap, 5> m_shadowMapPool;
+	glUtil::ShadowMap* m_shadowMap;
+	bool m_shadowAdaptiveSize; // pick the size from the texel density the view needs
+	uint32_t m_shadowResizeFrames; // consecutive frames in which the size should change
 	bool m_useShadowMap;
 	bool m_shadowCullFront;
 	bool m_shadowUsePolygonOffset;
 	GLfloat m_shadowPolygonOffsetFactor;
 	GLfloat m_shadowPolygonOffsetUnits;
+	GLfloat m_shadowLinearOffsetUnits; // units of the offset the linear depth programs apply, in 16 bit steps
+	bool m_shadowUseStaticCache; // render static casters into a separate cached cube map
+	bool m_shadowCullByReceivers; // skip casters whose shadow cannot reach a visible mesh
+	bool m_shadowUseLayered; // render all faces in one pass through a geometry shader
+	bool m_shadowLinearDepth; // store 16 bit linear distance with the near plane fitted to the light radius
+	ShadowFilter m_shadowFilter; // filtering of the cube shadow map
+	bool m_shadowUseSoftware; // rasterize the cube shadow map on the CPU
+	SoftwareShadowMap m_softwareShadowMap;
+
+	// Meshes within the camera frustum and the combined bounds of those 
+	// meshes which are within the light radius
+	std::vector<MeshInstance> m_visibleMeshes;
+	std::vector<BoundingBox> m_visibleReceivers;
+	BoundingBox m_visibleReceiverBounds;
+
+	RenderQueue m_renderQueue;
+
+	// Transform and material indices of the instances of all batches of the 
+	// current pass
+	std::vector<glUtil::DrawInstance> m_instanceData;
+	GLuint m_instanceBuffer;
+
+	// Multi draw indirect path (GL 4.3). Draws meshes from the geometry 
+	// arena, one indirect command per batch.
+	bool m_multiDrawIndirectSupported;
+	bool m_useMultiDrawIndirect;
+	GeometryArena m_geometryArena;
+	std::vector<DrawElementsIndirectCommand> m_indirectCommands;
+	GLuint m_indirectBuffer;
+
+	// Batches of the current frame. Static face batches render the cached 
+	// static casters, face batches render the shadow map.
+	std::array<std::vector<DrawBatch>, 6> m_staticFaceBatches;
+	std::array<std::vector<DrawBatch>, 6> m_faceBatches;
+	std::vector<DrawBatch> m_lightBatches;
+
+	// Batches of the layered shadow pass, which replace the face batches
+	std::vector<DrawBatch> m_staticLayeredBatches;
+	std::vector<DrawBatch> m_layeredBatches;
+
+	// Shadow casters of the current frame
+	std::vector<ShadowCaster> m_staticShadowCasters;
+	std::vector<ShadowCaster> m_dynamicShadowCasters;
+
+	ShadowMapState m_shadowMapState; // state of the shadow map
+	ShadowMapState m_staticShadowMapState; // state of the cached static shadow casters
+	ShadowMapState m_momentMapState; // state of the moment cube map
+
+	// Bounds of the casters rendered directly into the shadow map by id
+	std::unordered_map<uint64_t, BoundingBox> m_shadowMapCasterBounds;
+
+	// Shadow maps of the additional point lights. The slots and states are 
+	// indexed by the light.
+	bool m_usePointLights;
+	ShadowAllocator m_shadowAllocator;
+	GLuint m_pointShadowFramebuffer;
+	std::vector<ShadowAllocator::Slot> m_pointShadowSlots;
+	std::vector<PointShadowState> m_pointShadowStates;
+	uint32_t m_pointShadowFaceBudget; // faces rendered per frame at most
+	size_t m_pointShadowRoundRobin; // next face position of the round-robin updates
+	std::vector<ShadowCaster> m_pointShadowCasters;
+	std::vector<PointShadowFace> m_pointShadowFaces;
+
+	// Baked visibility of the point lights, read from its own texture unit
+	bool m_useBakedLighting;
+	bool m_useBakedVisibility; // baked lighting is enabled and the bake matches the static nodes of this frame
+	LightBaker m_lightBaker;
+	GLuint m_bakedVisibilityBuffer;
+	GLuint m_bakedVisibilityTexture; // texture buffer view of m_bakedVisibilityBuffer
+
+	RenderStats m_stats;
+	RenderTotals m_totals;
 
 	Input* m_input;
 };
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "scene/boundingBox.hpp"
+
+#include <glm/glm.hpp>
+
+#include <limits>
+
+
+BoundingBox::BoundingBox()
+	: min(std::numeric_limits<float>::max())
+	, max(std::numeric_limits<float>::lowest())
+{
+}
+
+BoundingBox::BoundingBox(glm::vec3 min, glm::vec3 max)
+	: min(min)
+	, max(max)
+{
+}
+
+void BoundingBox::extend(glm::vec3 point)
+{
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+void BoundingBox::extend(BoundingBox const& other)
+{
+	min = glm::min(min, other.min);
+	max = glm::max(max, other.max);
+}
+
+bool BoundingBox::isEmpty() const
+{
+	return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+glm::vec3 BoundingBox::getCenter() const
+{
+	return 0.5f * (min + max);
+}
+
+glm::vec3 BoundingBox::getHalfExtent() const
+{
+	return 0.5f * (max - min);
+}
+
+glm::vec3 BoundingBox::getCorner(unsigned index) const
+{
+	return glm::vec3(
+		(index & 1) ? max.x : min.x,
+		(index & 2) ? max.y : min.y,
+		(index & 4) ? max.z : min.z
+	);
+}
+
+BoundingBox BoundingBox::transform(glm::mat4 const& matrix) const
+{
+	if (isEmpty())
+	{
+		return BoundingBox();
+	}
+
+	// Transform the center and project the extent onto the new axes
+	glm::vec3 center = glm::vec3(matrix * glm::vec4(getCenter(), 1.f));
+	glm::vec3 extent = getHalfExtent();
+	glm::vec3 newExtent = 
+		glm::abs(glm::vec3(matrix[0])) * extent.x +
+		glm::abs(glm::vec3(matrix[1])) * extent.y +
+		glm::abs(glm::vec3(matrix[2])) * extent.z;
+
+	return BoundingBox(center - newExtent, center + newExtent);
+}
+
+bool BoundingBox::intersects(BoundingBox const& other) const
+{
+	return 
+		min.x <= other.max.x && max.x >= other.min.x &&
+		min.y <= other.max.y && max.y >= other.min.y &&
+		min.z <= other.max.z && max.z >= other.min.z;
+}
+
+bool BoundingBox::intersectsSphere(glm::vec3 center, float radius) const
+{
+	if (isEmpty())
+	{
+		return false;
+	}
+
+	// Distance between the sphere center and the closest point of the box
+	glm::vec3 delta = center - glm::clamp(center, min, max);
+
+	return glm::dot(delta, delta) <= radius * radius;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+
+// Axis aligned bounding box
+struct BoundingBox
+{
+	// Creates an empty bounding box which contains no points
+	BoundingBox();
+	BoundingBox(glm::vec3 min, glm::vec3 max);
+
+	// Grows the bounding box so that it contains the point or box
+	void extend(glm::vec3 point);
+	void extend(BoundingBox const& other);
+
+	// Returns true if the bounding box does not contain any point
+	bool isEmpty() const;
+
+	glm::vec3 getCenter() const;
+	glm::vec3 getHalfExtent() const;
+
+	// Returns one of the eight corners. Bit 0, 1 and 2 of the index select 
+	// the maximum instead of the minimum along x, y and z.
+	glm::vec3 getCorner(unsigned index) const;
+
+	// Returns the bounding box of this box after applying the transformation
+	BoundingBox transform(glm::mat4 const& matrix) const;
+
+	// Returns true if both boxes overlap
+	bool intersects(BoundingBox const& other) const;
+
+	// Returns true if the box overlaps the sphere
+	bool intersectsSphere(glm::vec3 center, float radius) const;
+
+	glm::vec3 min;
+	glm::vec3 max;
+};
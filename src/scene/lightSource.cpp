@@ -5,13 +5,46 @@ LightSource::LightSource()
 	, Ia(1.f)
 	, Id(1.f)
 	, Is(1.f)
+	, radius(25.f)
+	, shadowMapType(SHADOW_MAP_CUBE)
+	, version(0)
 {
 }
 
-LightSource::LightSource(glm::vec3 position, glm::vec4 Ia, glm::vec4 Id, glm::vec4 Is)
+LightSource::LightSource(glm::vec3 position, glm::vec4 Ia, glm::vec4 Id, glm::vec4 Is, float radius)
 	: position(position)
 	, Ia(Ia)
 	, Id(Id)
 	, Is(Is)
+	, radius(radius)
+	, shadowMapType(SHADOW_MAP_CUBE)
+	, version(0)
 {
 }
+
+void LightSource::setPosition(glm::vec3 newPosition)
+{
+	if (position != newPosition)
+	{
+		position = newPosition;
+		version++;
+	}
+}
+
+void LightSource::setRadius(float newRadius)
+{
+	if (radius != newRadius)
+	{
+		radius = newRadius;
+		version++;
+	}
+}
+
+void LightSource::setShadowMapType(ShadowMapType newShadowMapType)
+{
+	if (shadowMapType != newShadowMapType)
+	{
+		shadowMapType = newShadowMapType;
+		version++;
+	}
+}
@@ -3,13 +3,34 @@
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
+#include <cstdint>
+
+// Parameterization of the shadow map of a point light. The values are used
+// by the shaders.
+enum ShadowMapType
+{
+	SHADOW_MAP_CUBE = 0, // six faces, six geometry passes
+	SHADOW_MAP_DUAL_PARABOLOID = 1, // two hemispheres, two geometry passes
+	SHADOW_MAP_TETRAHEDRAL = 2, // four frusta in a single 2D map, four geometry passes
+};
+
 struct LightSource
 {
 	LightSource();
-	LightSource(glm::vec3 position, glm::vec4 Ia, glm::vec4 Id, glm::vec4 Is);
+	LightSource(glm::vec3 position, glm::vec4 Ia, glm::vec4 Id, glm::vec4 Is, float radius);
+
+	// Use these setters to move the light or change its radius, so that the
+	// version is incremented and the shadow map is updated.
+	void setPosition(glm::vec3 newPosition);
+	void setRadius(float newRadius);
+	void setShadowMapType(ShadowMapType newShadowMapType);
 
 	glm::vec3 position;
 	glm::vec4 Ia;
 	glm::vec4 Id;
 	glm::vec4 Is;
+	float radius; // influence radius, nothing further away is lit or shadowed
+	ShadowMapType shadowMapType;
+
+	uint64_t version; // incremented whenever the position, radius or shadow map type changes
 };
\ No newline at end of file
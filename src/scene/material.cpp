@@ -6,9 +6,10 @@ Material::Material()
 	, Ks(0.1f)
 	, Ns(1.f)
 	, d(1.f)
-	, textureKa(0)
-	, textureKd(0)
-	, textureKs(0)
+	, textureKa({ 0, 0 })
+	, textureKd({ 0, 0 })
+	, textureKs({ 0, 0 })
+	, index(0)
 {
 }
 
@@ -18,59 +19,23 @@ Material::Material(glm::vec4 Ka, glm::vec4 Kd, glm::vec4 Ks, float Ns, float d)
 	, Ks(Ks)
 	, Ns(Ns)
 	, d(d)
-	, textureKa(0)
-	, textureKd(0)
-	, textureKs(0)
+	, textureKa({ 0, 0 })
+	, textureKd({ 0, 0 })
+	, textureKs({ 0, 0 })
+	, index(0)
 {
 }
 
-Material::Material(Material&& other)
-	: Ka(other.Ka)
-	, Kd(other.Kd)
-	, Ks(other.Ks)
-	, Ns(other.Ns)
-	, d(other.d)
-	, textureKa(other.textureKa)
-	, textureKd(other.textureKd)
-	, textureKs(other.textureKs)
+MaterialUniforms Material::getUniforms() const
 {
-	other.textureKa = 0;
-	other.textureKd = 0;
-	other.textureKs = 0;
+	MaterialUniforms uniforms = {};
+	uniforms.ka = Ka;
+	uniforms.kd = Kd;
+	uniforms.ks = Ks;
+	uniforms.shininess = Ns;
+	uniforms.layerKa = textureKa.texture != 0 ? static_cast<float>(textureKa.layer) : -1.f;
+	uniforms.layerKd = textureKd.texture != 0 ? static_cast<float>(textureKd.layer) : -1.f;
+	uniforms.layerKs = textureKs.texture != 0 ? static_cast<float>(textureKs.layer) : -1.f;
+
+	return uniforms;
 }
-
-Material& Material::operator=(Material&& other)
-{
-	Ka = other.Ka;
-	Kd = other.Kd;
-	Ks = other.Ks;
-	Ns = other.Ns;
-	d = other.d;
-	textureKa = other.textureKa;
-	textureKd = other.textureKd;
-	textureKs = other.textureKs;
-
-	other.textureKa = 0;
-	other.textureKd = 0;
-	other.textureKs = 0;
-
-	return *this;
-}
-
-Material::~Material()
-{
-	if (textureKa != 0)
-	{
-		glDeleteTextures(1, &textureKa);
-	}
-
-	if (textureKd != 0)
-	{
-		glDeleteTextures(1, &textureKd);
-	}
-
-	if (textureKs != 0)
-	{
-		glDeleteTextures(1, &textureKs);
-	}
-}
\ No newline at end of file
@@ -1,26 +1,33 @@
 #pragma once
 
+#include "scene/textureArrayPool.hpp"
+
 #include <GL/glew.h>
 #include <glm/vec4.hpp>
 
+#include <cstdint>
+
+
+// Material parameters as stored in the material buffer, one RGBA32F texel 
+// per member. The layers are -1 if the material has no such texture.
+struct MaterialUniforms
+{
+	glm::vec4 ka;
+	glm::vec4 kd;
+	glm::vec4 ks;
+	float shininess;
+	float layerKa;
+	float layerKd;
+	float layerKs;
+};
 
 struct Material
 {
 	Material();
 	Material(glm::vec4 Ka, glm::vec4 Kd, glm::vec4 Ks, float Ns, float d);
 
-	// Move constructor
-	Material(Material&& other);
-
-	// Move assignment
-	Material& operator=(Material&& other);
-
-	// Destructor
-	~Material();
-
-	// Delete copy constructor and copy assignment operator
-	Material(Material const&) = delete;
-	Material& operator=(Material const&) = delete;
+	// Returns the parameters in the layout of the material buffer
+	MaterialUniforms getUniforms() const;
 
 	glm::vec4 Ka; // ambient color
 	glm::vec4 Kd; // diffuse color
@@ -28,7 +35,9 @@ struct Material
 	float Ns; // specular exponent
 	float d; // dissolve i.e. transparency (1.0 means fully opaque)
 
-	GLuint textureKa; // ambient color texture
-	GLuint textureKd; // diffuse color texture
-	GLuint textureKs; // specular color texture
-};
\ No newline at end of file
+	TextureLayer textureKa; // ambient color texture
+	TextureLayer textureKd; // diffuse color texture
+	TextureLayer textureKs; // specular color texture
+
+	uint32_t index; // index within the material buffer, assigned by the scene graph
+};
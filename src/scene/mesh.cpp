@@ -8,14 +8,23 @@
 Mesh::Mesh(std::vector<Vertex> const& vertices, std::vector<uint32_t> const& indices, Material const& material)
 	: numVertices(static_cast<uint32_t>(vertices.size()))
 	, numIndices(static_cast<uint32_t>(indices.size()))
+	, vertices(vertices)
+	, indices(indices)
 	, material(material)
 	, vertexArrayObject(Vertex::createVertexArrayObject(vertices, indices))
 {
+	for (Vertex const& vertex : vertices)
+	{
+		bounds.extend(vertex.position);
+	}
 }
 
 Mesh::Mesh(Mesh&& other)
 	: numVertices(other.numVertices)
 	, numIndices(other.numIndices)
+	, bounds(other.bounds)
+	, vertices(std::move(other.vertices))
+	, indices(std::move(other.indices))
 	, material(other.material)
 	, vertexArrayObject(other.vertexArrayObject)
 {
@@ -34,7 +43,8 @@ void Mesh::readObj(
 	std::string directory, 
 	std::string filename, 
 	std::vector<std::unique_ptr<Mesh>>& outMeshes, 
-	std::vector<std::unique_ptr<Material>>& outMaterials)
+	std::vector<std::unique_ptr<Material>>& outMaterials,
+	TextureArrayPool& textureArrays)
 {
 	// Container for tinyObjLoader to write to
 	tinyobj::attrib_t attrib;
@@ -63,6 +73,7 @@ void Mesh::readObj(
 	}
 
 	// Create Materials
+	std::vector<uint32_t> textureImages(3 * materials.size(), TextureArrayPool::INVALID_IMAGE);
 	for (int i = 0; i < materials.size(); i++) 
 	{
 		glm::vec4  Ka = glm::vec4(materials[i].ambient [0], materials[i].ambient [1], materials[i].ambient [2], materials[i].ambient [2]);
@@ -74,28 +85,39 @@ void Mesh::readObj(
 		// Create the material
 		auto mat = std::make_unique<Material>(Ka, Kd, Ks, Ns, d);
 
-		// Create textures if present
+		// Read textures if present
 		if (!materials[i].ambient_texname.empty()) 
 		{
 			std::string texturePath = directory + "/" + materials[i].ambient_texname;
-			mat->textureKa = glUtil::createTexture(texturePath);
+			textureImages[3 * i + 0] = textureArrays.add(texturePath);
 		}
 
 		if (!materials[i].diffuse_texname.empty())
 		{
 			std::string texturePath = directory + "/" + materials[i].diffuse_texname;
-			mat->textureKd = glUtil::createTexture(texturePath);
+			textureImages[3 * i + 1] = textureArrays.add(texturePath);
 		}
 
 		if (!materials[i].specular_texname.empty())
 		{
 			std::string texturePath = directory + "/" + materials[i].specular_texname;
-			mat->textureKs = glUtil::createTexture(texturePath);
+			textureImages[3 * i + 2] = textureArrays.add(texturePath);
 		}
 
 		// Push the material into the vector
 		outMaterials.push_back(std::move(mat));
 	}
+
+	// Create the texture arrays once all images are known
+	textureArrays.build();
+	size_t firstMaterial = outMaterials.size() - materials.size();
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		Material& mat = *outMaterials[firstMaterial + i];
+		mat.textureKa = textureArrays.getLayer(textureImages[3 * i + 0]);
+		mat.textureKd = textureArrays.getLayer(textureImages[3 * i + 1]);
+		mat.textureKs = textureArrays.getLayer(textureImages[3 * i + 2]);
+	}
 	
 	// Iterate trough all the shapes/meshes
 	SPDLOG_TRACE("Processing vertex data... ");
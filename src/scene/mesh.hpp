@@ -2,6 +2,7 @@
 
 #include "scene/vertex.hpp"
 #include "scene/material.hpp"
+#include "scene/boundingBox.hpp"
 
 #include <GL/glew.h>
 
@@ -29,13 +30,20 @@ struct Mesh
 	GLuint vertexArrayObject;
 	uint32_t numVertices;
 	uint32_t numIndices;
+	BoundingBox bounds; // bounds in model space
+
+	// Copies of the geometry in host memory
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
 
 	Material const& material;
 
-	// Reads an obj file. Returns an array of meshes and materials
+	// Reads an obj file. Returns an array of meshes and materials. The 
+	// textures of the materials are added to textureArrays.
 	static void readObj(
 		std::string directory,
 		std::string filename,
 		std::vector<std::unique_ptr<Mesh>>& outMeshes,
-		std::vector<std::unique_ptr<Material>>& outMaterials);
+		std::vector<std::unique_ptr<Material>>& outMaterials,
+		TextureArrayPool& textureArrays);
 };
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 
 SceneGraph::SceneGraph()
+	: m_staticCasterVersion(0)
+	, m_dynamicCasterVersion(0)
+	, m_staticVersion(0)
 {
 	// Create the root node
 	SceneNode node = {};
@@ -10,6 +13,7 @@ SceneGraph::SceneGraph()
 	node.nodeMatrix = glm::mat4(1.f);
 	node.modelMatrix = glm::mat4(1.f);
 	node.castsShadow = true;
+	node.isStatic = true;
 
 	// Add the root node
 	m_nodes.push_back(node);
@@ -42,6 +46,7 @@ std::vector<Mesh*> SceneGraph::takeMeshes(std::vector<std::unique_ptr<Mesh>>& me
 
 Material* SceneGraph::takeMaterial(std::unique_ptr<Material> material)
 {
+	material->index = static_cast<uint32_t>(m_materials.size());
 	m_materials.push_back(std::move(material));
 
 	return m_materials.back().get();
@@ -54,6 +59,7 @@ std::vector<Material*> SceneGraph::takeMaterials(std::vector<std::unique_ptr<Mat
 
 	for (auto& material : materials)
 	{
+		material->index = static_cast<uint32_t>(m_materials.size());
 		m_materials.push_back(std::move(material));
 		references.push_back(m_materials.back().get());
 	}
@@ -61,7 +67,17 @@ std::vector<Material*> SceneGraph::takeMaterials(std::vector<std::unique_ptr<Mat
 	return references;
 }
 
-size_t SceneGraph::addNode(size_t parent, bool castsShadow, glm::mat4 initialTransformation)
+std::vector<std::unique_ptr<Material>> const& SceneGraph::getMaterials() const
+{
+	return m_materials;
+}
+
+TextureArrayPool& SceneGraph::getTextureArrays()
+{
+	return m_textureArrays;
+}
+
+size_t SceneGraph::addNode(size_t parent, bool castsShadow, glm::mat4 initialTransformation, bool isStatic)
 {
 	// Create the new node
 	SceneNode node = {};
@@ -70,6 +86,7 @@ size_t SceneGraph::addNode(size_t parent, bool castsShadow, glm::mat4 initialTra
 	node.nodeMatrix = initialTransformation;
 	node.modelMatrix = glm::mat4(1.f);
 	node.castsShadow = castsShadow;
+	node.isStatic = isStatic;
 
 	// Add the node to the parents childes
 	m_nodes[parent].children.push_back(node.index);
@@ -82,14 +99,18 @@ size_t SceneGraph::addNode(size_t parent, bool castsShadow, glm::mat4 initialTra
 
 void SceneGraph::addNodeMesh(size_t nodeIdx, Mesh* mesh)
 {
-	m_nodes[nodeIdx].meshes.push_back(mesh);
+	SceneNode& node = m_nodes[nodeIdx];
+	node.meshes.push_back(mesh);
+	node.meshBounds.push_back(mesh->bounds.transform(node.modelMatrix));
+
+	nodeChanged(node);
 }
 
 void SceneGraph::addNodeMeshes(size_t nodeIdx, std::vector<Mesh*>& meshes)
 {
 	for (auto mesh : meshes)
 	{
-		m_nodes[nodeIdx].meshes.push_back(mesh);
+		addNodeMesh(nodeIdx, mesh);
 	}
 }
 
@@ -103,11 +124,36 @@ std::vector<SceneGraph::SceneNode> const& SceneGraph::getNodes() const
 	return m_nodes;
 }
 
+uint64_t SceneGraph::getCasterVersion() const
+{
+	return m_staticCasterVersion + m_dynamicCasterVersion;
+}
+
+uint64_t SceneGraph::getStaticCasterVersion() const
+{
+	return m_staticCasterVersion;
+}
+
+uint64_t SceneGraph::getDynamicCasterVersion() const
+{
+	return m_dynamicCasterVersion;
+}
+
+uint64_t SceneGraph::getStaticVersion() const
+{
+	return m_staticVersion;
+}
+
 void SceneGraph::update()
 {
 	// Update root node
 	SceneNode& root = m_nodes[0];
+	if (root.modelMatrix != root.nodeMatrix)
+	{
+		nodeChanged(root);
+	}
 	root.modelMatrix = root.nodeMatrix;
+	updateMeshBounds(root);
 
 	// Update children recursively
 	for (size_t child : root.children)
@@ -121,11 +167,52 @@ void SceneGraph::updateModelMatrix(size_t nodeIdx)
 	// Update the transformation of this node
 	SceneNode& node = m_nodes[nodeIdx];
 	SceneNode& parent = m_nodes[node.parent];
-	node.modelMatrix = parent.modelMatrix * node.nodeMatrix;
+	glm::mat4 modelMatrix = parent.modelMatrix * node.nodeMatrix;
+	if (node.modelMatrix != modelMatrix)
+	{
+		nodeChanged(node);
+	}
+	node.modelMatrix = modelMatrix;
+	updateMeshBounds(node);
 
 	// Update the transformation of all its children
 	for (size_t childrenIdx : node.children)
 	{
 		updateModelMatrix(childrenIdx);
 	}
+}
+
+void SceneGraph::updateMeshBounds(SceneNode& node)
+{
+	for (size_t i = 0; i < node.meshes.size(); ++i)
+	{
+		node.meshBounds[i] = node.meshes[i]->bounds.transform(node.modelMatrix);
+	}
+}
+
+void SceneGraph::nodeChanged(SceneNode const& node)
+{
+	if (node.meshes.empty())
+	{
+		return;
+	}
+
+	if (node.isStatic)
+	{
+		m_staticVersion++;
+	}
+
+	if (!node.castsShadow)
+	{
+		return;
+	}
+
+	if (node.isStatic)
+	{
+		m_staticCasterVersion++;
+	}
+	else
+	{
+		m_dynamicCasterVersion++;
+	}
 }
\ No newline at end of file
@@ -2,11 +2,14 @@
 
 #include "scene/mesh.hpp"
 #include "scene/material.hpp"
+#include "scene/textureArrayPool.hpp"
+#include "scene/boundingBox.hpp"
 
 #include <glm/mat4x4.hpp>
 
 #include <memory>
 #include <vector>
+#include <cstdint>
 
 
 class SceneGraph
@@ -20,11 +23,13 @@ public:
 		std::vector<size_t> children; // Indices of the child nodes
 
 		std::vector<Mesh*> meshes; // Meshes which are attached to this node
+		std::vector<BoundingBox> meshBounds; // World space bounds of each attached mesh
 
 		glm::mat4 nodeMatrix; // Transformation of this node
 		glm::mat4 modelMatrix; // Combined transformation of this node and all its parents
 
 		bool castsShadow; // If false, this node is not rendered in the shadow pass
+		bool isStatic; // If false, the node is expected to move. Static shadow casters are cached.
 	};
 
 private:
@@ -32,6 +37,15 @@ private:
 
 	std::vector<std::unique_ptr<Mesh>> m_meshes; // Stores all the meshes used by the scene graph
 	std::vector<std::unique_ptr<Material>> m_materials; // Stores all materials used within the scene
+	TextureArrayPool m_textureArrays; // Stores the textures of all materials
+
+	// Incremented whenever a static or a dynamic shadow caster is added or moved
+	uint64_t m_staticCasterVersion;
+	uint64_t m_dynamicCasterVersion;
+
+	// Incremented whenever a mesh is added to a static node or a static node
+	// with meshes moves, whether it casts shadows or not
+	uint64_t m_staticVersion;
 
 public:
 	SceneGraph();
@@ -41,12 +55,18 @@ public:
 	Mesh* takeMesh(std::unique_ptr<Mesh> mesh);
 	std::vector<Mesh*> takeMeshes(std::vector<std::unique_ptr<Mesh>>& meshes);
 
-	// Takes ownership of a material
+	// Takes ownership of a material and assigns its index
 	Material* takeMaterial(std::unique_ptr<Material> material);
 	std::vector<Material*> takeMaterials(std::vector<std::unique_ptr<Material>>& materials);
 
+	// Returns all materials. The index of a material is its position.
+	std::vector<std::unique_ptr<Material>> const& getMaterials() const;
+
+	// Returns the pool which holds the textures of the materials
+	TextureArrayPool& getTextureArrays();
+
 	// Adds a new node to the scene graph
-	size_t addNode(size_t parent, bool castsShadow, glm::mat4 initialTransformation = glm::mat4(1));
+	size_t addNode(size_t parent, bool castsShadow, glm::mat4 initialTransformation = glm::mat4(1), bool isStatic = true);
 
 	// Adds a mesh to the specified node
 	void addNodeMesh(size_t nodeIdx, Mesh* mesh);
@@ -59,11 +79,29 @@ public:
 	// Returns the nodes vector
 	std::vector<SceneNode> const& getNodes() const;
 
+	// Returns a counter which changes whenever the set of shadow casters or
+	// the transformation of a shadow caster changes
+	uint64_t getCasterVersion() const;
+
+	// Same as getCasterVersion() but only considers static or dynamic casters
+	uint64_t getStaticCasterVersion() const;
+	uint64_t getDynamicCasterVersion() const;
+
+	// Changes whenever the geometry of the static nodes changes
+	uint64_t getStaticVersion() const;
+
 	// Recomputes the model matrix of each node i.e. multiplies the local transformation of 
-	// each nodes with the transformations of all its parents.
+	// each nodes with the transformations of all its parents. Also updates the world space
+	// bounds of the attached meshes.
 	void update();
 
 private:
 	// Recursively updates the model matrices of all child nodes
 	void updateModelMatrix(size_t nodeIdx);
+
+	// Transforms the bounds of all meshes of the node into world space
+	void updateMeshBounds(SceneNode& node);
+
+	// Increments the static version and the caster version matching the node
+	void nodeChanged(SceneNode const& node);
 };
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "scene/textureArrayPool.hpp"
+
+#include "log.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <algorithm>
+
+
+TextureArrayPool::TextureArrayPool()
+	: m_imageIds()
+	, m_layers()
+	, m_pendingImages()
+	, m_textures()
+{
+}
+
+TextureArrayPool::~TextureArrayPool()
+{
+	for (PendingImage& image : m_pendingImages)
+	{
+		stbi_image_free(image.pixels);
+	}
+
+	if (!m_textures.empty())
+	{
+		glDeleteTextures(static_cast<GLsizei>(m_textures.size()), m_textures.data());
+	}
+}
+
+uint32_t TextureArrayPool::add(std::string const& path)
+{
+	auto it = m_imageIds.find(path);
+	if (it != m_imageIds.end())
+	{
+		return it->second;
+	}
+
+	// Read texture file
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+	if (pixels == nullptr)
+	{
+		SPDLOG_ERROR("Cannot open texture file \"{0}\"", path);
+		return INVALID_IMAGE;
+	}
+
+	uint32_t id = static_cast<uint32_t>(m_layers.size());
+	m_layers.push_back({ 0, 0 });
+	m_pendingImages.push_back({ id, texWidth, texHeight, GL_RGBA8, pixels });
+	m_imageIds[path] = id;
+
+	return id;
+}
+
+void TextureArrayPool::build()
+{
+	if (m_pendingImages.empty())
+	{
+		return;
+	}
+
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+	// Group the images by size and format
+	std::map<std::tuple<GLsizei, GLsizei, GLenum>, std::vector<PendingImage const*>> groups;
+	for (PendingImage const& image : m_pendingImages)
+	{
+		groups[std::make_tuple(image.width, image.height, image.format)].push_back(&image);
+	}
+
+	for (auto const& group : groups)
+	{
+		std::vector<PendingImage const*> const& images = group.second;
+		GLsizei width = std::get<0>(group.first);
+		GLsizei height = std::get<1>(group.first);
+		GLenum format = std::get<2>(group.first);
+
+		// Groups which exceed the layer limit are split into several textures
+		for (size_t first = 0; first < images.size(); first += maxLayers)
+		{
+			GLsizei layers = static_cast<GLsizei>(std::min(images.size() - first, static_cast<size_t>(maxLayers)));
+
+			// Generate texture object
+			GLuint texture = 0;
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+
+			// Set the texture data, one layer per image
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			for (GLsizei layer = 0; layer < layers; ++layer)
+			{
+				PendingImage const& image = *images[first + layer];
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+				m_layers[image.id] = { texture, layer };
+			}
+
+			// Generate mipmap
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+			// Set wrapping
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+			// Set filtering method
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			m_textures.push_back(texture);
+
+			SPDLOG_DEBUG("Created {}x{} texture array with {} layers", width, height, layers);
+		}
+	}
+
+	// Unbind texture
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	for (PendingImage& image : m_pendingImages)
+	{
+		stbi_image_free(image.pixels);
+	}
+	m_pendingImages.clear();
+}
+
+TextureLayer TextureArrayPool::getLayer(uint32_t image) const
+{
+	if (image == INVALID_IMAGE)
+	{
+		return { 0, 0 };
+	}
+
+	return m_layers[image];
+}
+
+size_t TextureArrayPool::getTextureCount() const
+{
+	return m_textures.size();
+}
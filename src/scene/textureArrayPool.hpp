@@ -0,0 +1,65 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <map>
+#include <tuple>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+
+
+// Layer of a 2D array texture
+struct TextureLayer
+{
+	GLuint texture; // GL_TEXTURE_2D_ARRAY, 0 if there is no texture
+	GLint layer;
+};
+
+// Collects images and stores them as layers of GL_TEXTURE_2D_ARRAY 
+// textures. Images with the same size and format share an array texture, 
+// so draws which only differ in their images share the same bindings.
+class TextureArrayPool
+{
+public:
+	// Returned by add() if the image cannot be loaded
+	static uint32_t const INVALID_IMAGE = ~0u;
+
+	TextureArrayPool();
+	~TextureArrayPool();
+
+	// Delete copy constructor and copy assignment operator
+	TextureArrayPool(TextureArrayPool const&) = delete;
+	TextureArrayPool& operator=(TextureArrayPool const&) = delete;
+
+	// Reads an image file. Returns an id to look up its layer after build().
+	// Adding the same path twice returns the same id.
+	uint32_t add(std::string const& path);
+
+	// Creates the array textures for all images added since the last call
+	// and frees the pixel data
+	void build();
+
+	// Returns the layer of an image. Only valid after build().
+	TextureLayer getLayer(uint32_t image) const;
+
+	// Returns the number of array textures
+	size_t getTextureCount() const;
+
+private:
+	// Pixel data of an image which has not been built yet
+	struct PendingImage
+	{
+		uint32_t id;
+		GLsizei width;
+		GLsizei height;
+		GLenum format;
+		unsigned char* pixels;
+	};
+
+	std::unordered_map<std::string, uint32_t> m_imageIds;
+	std::vector<TextureLayer> m_layers; // layer of each image id
+	std::vector<PendingImage> m_pendingImages;
+	std::vector<GLuint> m_textures;
+};
@@ -1,5 +1,7 @@
 #include "scene/vertex.hpp"
 
+#include "glUtil.hpp"
+
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
 
@@ -77,6 +79,10 @@ GLuint Vertex::createVertexArrayObject(std::vector<Vertex> const& vertices, std:
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, textureCoordinates));
 	glEnableVertexAttribArray(2);
 
+	// The per instance draw id. The renderer sets its buffer.
+	glEnableVertexAttribArray(glUtil::DRAW_ID_ATTRIBUTE);
+	glVertexAttribDivisor(glUtil::DRAW_ID_ATTRIBUTE, 1);
+
 	GLuint indexBuffer;
 	glGenBuffers(1, &indexBuffer);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
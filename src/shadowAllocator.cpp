@@ -0,0 +1,207 @@
+#include "shadowAllocator.hpp"
+
+#include "log.hpp"
+
+#include <numeric>
+#include <algorithm>
+
+
+ShadowAllocator::ShadowAllocator()
+	: m_tiers()
+	, m_slots()
+	, m_usedBytes(0)
+{
+}
+
+ShadowAllocator::~ShadowAllocator()
+{
+	release();
+}
+
+void ShadowAllocator::init(std::vector<GLsizei> const& tierSizes, size_t budgetBytes, uint32_t maxLights)
+{
+	release();
+
+	std::vector<GLsizei> sizes = tierSizes;
+	std::sort(sizes.begin(), sizes.end(), std::greater<GLsizei>());
+
+	size_t tierBudget = budgetBytes / std::max<size_t>(sizes.size(), 1);
+	for (GLsizei size : sizes)
+	{
+		Tier tier = {};
+		tier.size = size;
+		tier.capacity = static_cast<GLint>(std::min<size_t>(tierBudget / getCubeMapBytes(size), maxLights));
+
+		// Tiers which do not fit a single cube map into their share are skipped
+		if (tier.capacity == 0)
+		{
+			SPDLOG_DEBUG("Shadow tier {} does not fit into the budget", size);
+			continue;
+		}
+
+		// Generate and bind a new cube map array texture
+		glGenTextures(1, &tier.texture);
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, tier.texture);
+		glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 0, GL_DEPTH_COMPONENT, size, size, 6 * tier.capacity, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+
+		// Set texture parameters
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+
+		// Set comparison mode
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+
+		m_tiers.push_back(tier);
+
+		SPDLOG_DEBUG("Shadow tier {}: {} cube maps", size, tier.capacity);
+	}
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+	SPDLOG_INFO("Allocated {} MiB of {} MiB shadow budget", getAllocatedBytes() >> 20, budgetBytes >> 20);
+}
+
+void ShadowAllocator::allocate(std::vector<Request> const& requests, std::vector<Slot>& slots)
+{
+	slots.assign(requests.size(), { -1, 0, 0, false });
+	m_usedBytes = 0;
+
+	// Serve the most important lights first
+	std::vector<size_t> order(requests.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&requests](size_t a, size_t b) {
+		return requests[a].importance > requests[b].importance;
+	});
+
+	std::vector<std::vector<bool>> used(m_tiers.size());
+	for (size_t i = 0; i < m_tiers.size(); ++i)
+	{
+		used[i].assign(static_cast<size_t>(m_tiers[i].capacity), false);
+	}
+
+	// Lights which request the same tier as before keep their layer
+	for (size_t i : order)
+	{
+		auto previous = m_slots.find(requests[i].light);
+		if (previous == m_slots.end() || previous->second.tier != getTier(requests[i].size))
+		{
+			continue;
+		}
+
+		Slot slot = previous->second;
+		slot.isNew = false;
+		used[static_cast<size_t>(slot.tier)][static_cast<size_t>(slot.layer)] = true;
+		slots[i] = slot;
+	}
+
+	// The other lights take a free layer of their tier or of a smaller tier.
+	// The previous layer is preferred if the light ends up in the same tier.
+	for (size_t i : order)
+	{
+		if (slots[i].tier != -1)
+		{
+			continue;
+		}
+
+		auto previous = m_slots.find(requests[i].light);
+		for (int tier = getTier(requests[i].size); tier >= 0 && tier < static_cast<int>(m_tiers.size()) && slots[i].tier == -1; ++tier)
+		{
+			std::vector<bool>& tierUsed = used[static_cast<size_t>(tier)];
+			GLsizei tierSize = m_tiers[static_cast<size_t>(tier)].size;
+			if (previous != m_slots.end() && previous->second.tier == tier && !tierUsed[static_cast<size_t>(previous->second.layer)])
+			{
+				tierUsed[static_cast<size_t>(previous->second.layer)] = true;
+				slots[i] = { tier, previous->second.layer, tierSize, false };
+				continue;
+			}
+
+			auto freeLayer = std::find(tierUsed.begin(), tierUsed.end(), false);
+			if (freeLayer != tierUsed.end())
+			{
+				*freeLayer = true;
+				slots[i] = { tier, static_cast<GLint>(freeLayer - tierUsed.begin()), tierSize, true };
+			}
+		}
+	}
+
+	m_slots.clear();
+	for (size_t i = 0; i < requests.size(); ++i)
+	{
+		if (slots[i].tier != -1)
+		{
+			m_slots[requests[i].light] = slots[i];
+			m_usedBytes += getCubeMapBytes(slots[i].size);
+		}
+	}
+}
+
+int ShadowAllocator::getTier(GLsizei size) const
+{
+	// Tiers are sorted from largest to smallest
+	for (size_t i = 0; i < m_tiers.size(); ++i)
+	{
+		if (m_tiers[i].size <= size)
+		{
+			return static_cast<int>(i);
+		}
+	}
+
+	return static_cast<int>(m_tiers.size()) - 1;
+}
+
+size_t ShadowAllocator::getTierCount() const
+{
+	return m_tiers.size();
+}
+
+GLuint ShadowAllocator::getTexture(int tier) const
+{
+	return m_tiers[static_cast<size_t>(tier)].texture;
+}
+
+GLsizei ShadowAllocator::getTierSize(int tier) const
+{
+	return m_tiers[static_cast<size_t>(tier)].size;
+}
+
+GLint ShadowAllocator::getTierCapacity(int tier) const
+{
+	return m_tiers[static_cast<size_t>(tier)].capacity;
+}
+
+size_t ShadowAllocator::getAllocatedBytes() const
+{
+	size_t bytes = 0;
+	for (Tier const& tier : m_tiers)
+	{
+		bytes += static_cast<size_t>(tier.capacity) * getCubeMapBytes(tier.size);
+	}
+
+	return bytes;
+}
+
+size_t ShadowAllocator::getUsedBytes() const
+{
+	return m_usedBytes;
+}
+
+size_t ShadowAllocator::getCubeMapBytes(GLsizei size)
+{
+	// Six faces, assuming 32 bit depth
+	return 6 * static_cast<size_t>(size) * static_cast<size_t>(size) * 4;
+}
+
+void ShadowAllocator::release()
+{
+	for (Tier& tier : m_tiers)
+	{
+		glDeleteTextures(1, &tier.texture);
+	}
+	m_tiers.clear();
+	m_slots.clear();
+	m_usedBytes = 0;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+
+// Assigns cube shadow maps to many point lights. The maps are layers of 
+// cube map arrays, one array per resolution tier. Each tier gets an equal 
+// share of the memory budget. Lights are served in order of importance and
+// get a smaller tier if their own is full, or no shadow map at all.
+class ShadowAllocator
+{
+public:
+	// Shadow map of a light. The cube map occupies the layers 6 * layer to
+	// 6 * layer + 5 of the array texture of the tier.
+	struct Slot
+	{
+		int tier; // -1 if the light has no shadow map
+		GLint layer;
+		GLsizei size;
+		bool isNew; // true if the slot was not assigned to the light in the previous frame
+	};
+
+	// Shadow map request of a light for the current frame
+	struct Request
+	{
+		uint32_t light; // stable id of the light
+		float importance; // lights with higher importance are served first
+		GLsizei size; // desired resolution
+	};
+
+	ShadowAllocator();
+	~ShadowAllocator();
+
+	// Delete copy constructor and copy assignment operator
+	ShadowAllocator(ShadowAllocator const&) = delete;
+	ShadowAllocator& operator=(ShadowAllocator const&) = delete;
+
+	// Creates one cube map array per tier from largest to smallest size. 
+	// No tier holds more than maxLights maps.
+	void init(std::vector<GLsizei> const& tierSizes, size_t budgetBytes, uint32_t maxLights);
+
+	// Assigns a slot to every request, slots[i] belongs to requests[i]. A 
+	// light keeps its slot as long as it requests the same tier.
+	void allocate(std::vector<Request> const& requests, std::vector<Slot>& slots);
+
+	// Returns the tier whose size is closest to the desired size without 
+	// exceeding it, or the smallest tier
+	int getTier(GLsizei size) const;
+
+	size_t getTierCount() const;
+	GLuint getTexture(int tier) const;
+	GLsizei getTierSize(int tier) const;
+	GLint getTierCapacity(int tier) const;
+
+	// Memory of all array textures and of the slots assigned in the last frame
+	size_t getAllocatedBytes() const;
+	size_t getUsedBytes() const;
+
+	// Returns the memory of a cube map of the given size
+	static size_t getCubeMapBytes(GLsizei size);
+
+private:
+	struct Tier
+	{
+		GLsizei size;
+		GLint capacity; // number of cube maps
+		GLuint texture; // GL_TEXTURE_CUBE_MAP_ARRAY
+	};
+
+	void release();
+
+	std::vector<Tier> m_tiers;
+	std::unordered_map<uint32_t, Slot> m_slots; // slots of the last frame by light
+	size_t m_usedBytes;
+};
@@ -0,0 +1,534 @@
+#include "softwareShadowMap.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SSE2 is part of every x86-64 target
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define SOFTWARE_SHADOW_MAP_SSE2
+#include <emmintrin.h>
+#endif
+
+
+// Minimum resolvable difference of a 24 bit depth buffer, the unit of the
+// units parameter of glPolygonOffset
+static float const DEPTH_RESOLUTION = 1.f / 16777216.f;
+
+// Triangles are only clipped against the side planes of the frustum if they
+// reach outside of this multiple of the face. Smaller overhangs are left to
+// the bounds of the face, which keeps the clipped vertices out of the
+// common case and the window coordinates small enough for float edges.
+static float const GUARD_BAND = 4.f;
+
+// Planes triangles are clipped against in the order near, far and the 
+// left, right, bottom and top guard band. A vertex v is inside if 
+// dot(plane, v) >= 0.
+static glm::vec4 const CLIP_PLANES[6] = {
+	glm::vec4( 0.f,  0.f,  1.f, 1.f),
+	glm::vec4( 0.f,  0.f, -1.f, 1.f),
+	glm::vec4( 1.f,  0.f,  0.f, GUARD_BAND),
+	glm::vec4(-1.f,  0.f,  0.f, GUARD_BAND),
+	glm::vec4( 0.f,  1.f,  0.f, GUARD_BAND),
+	glm::vec4( 0.f, -1.f,  0.f, GUARD_BAND),
+};
+
+static size_t getThreadCount()
+{
+#ifdef _OPENMP
+	return static_cast<size_t>(omp_get_max_threads());
+#else
+	return 1;
+#endif
+}
+
+static size_t getThreadIndex()
+{
+#ifdef _OPENMP
+	return static_cast<size_t>(omp_get_thread_num());
+#else
+	return 0;
+#endif
+}
+
+SoftwareShadowMap::SoftwareShadowMap()
+	: m_size(0)
+	, m_tilesPerRow(0)
+	, m_faces()
+	, m_positions()
+	, m_indices()
+	, m_polygonOffsetFactor(0.f)
+	, m_polygonOffsetUnits(0.f)
+	, m_cullFace(CULL_BACK)
+	, m_clipVertices()
+	, m_threadTriangles()
+	, m_tileOffsets()
+	, m_tileTriangles()
+	, m_rasterizedTriangleCount(0)
+{
+}
+
+void SoftwareShadowMap::init(int size)
+{
+	if (size == m_size)
+	{
+		return;
+	}
+
+	m_size = size;
+	m_tilesPerRow = (size + TILE_SIZE - 1) / TILE_SIZE;
+	for (std::vector<float>& face : m_faces)
+	{
+		face.assign(static_cast<size_t>(size) * static_cast<size_t>(size), 1.f);
+	}
+}
+
+void SoftwareShadowMap::clear()
+{
+	m_positions.clear();
+	m_indices.clear();
+}
+
+void SoftwareShadowMap::addMesh(
+	glm::vec3 const* positions,
+	size_t stride,
+	size_t vertexCount,
+	std::vector<uint32_t> const& indices,
+	glm::mat4 const& modelMatrix
+)
+{
+	uint32_t firstVertex = static_cast<uint32_t>(m_positions.size());
+
+	char const* data = reinterpret_cast<char const*>(positions);
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		glm::vec3 const& position = *reinterpret_cast<glm::vec3 const*>(data + i * stride);
+		m_positions.push_back(glm::vec3(modelMatrix * glm::vec4(position, 1.f)));
+	}
+
+	for (uint32_t index : indices)
+	{
+		m_indices.push_back(firstVertex + index);
+	}
+}
+
+void SoftwareShadowMap::setPolygonOffset(float factor, float units)
+{
+	m_polygonOffsetFactor = factor;
+	m_polygonOffsetUnits = units;
+}
+
+void SoftwareShadowMap::setCullFace(CullFace cullFace)
+{
+	m_cullFace = cullFace;
+}
+
+void SoftwareShadowMap::render(std::array<glm::mat4, 6> const& faceViewProjections)
+{
+	m_threadTriangles.resize(getThreadCount());
+	for (std::array<std::vector<Triangle>, 6>& threadTriangles : m_threadTriangles)
+	{
+		for (std::vector<Triangle>& triangles : threadTriangles)
+		{
+			triangles.clear();
+		}
+	}
+
+	// Shared vertices are transformed once per face. The OpenMP loops keep
+	// signed indices, which OpenMP 2.0 requires.
+	int vertexCount = static_cast<int>(m_positions.size());
+	for (std::vector<ClipVertex>& clipVertices : m_clipVertices)
+	{
+		clipVertices.resize(m_positions.size());
+	}
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		transformVertex(static_cast<size_t>(i), faceViewProjections);
+	}
+
+	// Set up each triangle for every face whose frustum it reaches
+	int triangleCount = static_cast<int>(getTriangleCount());
+	#pragma omp parallel for schedule(dynamic, 1024)
+	for (int i = 0; i < triangleCount; ++i)
+	{
+		std::array<std::vector<Triangle>, 6>& triangles = m_threadTriangles[getThreadIndex()];
+		for (size_t face = 0; face < 6; ++face)
+		{
+			setupTriangle(static_cast<size_t>(i), face, triangles[face]);
+		}
+	}
+
+	#pragma omp parallel for
+	for (int face = 0; face < 6; ++face)
+	{
+		binTriangles(static_cast<size_t>(face));
+	}
+
+	m_rasterizedTriangleCount = 0;
+	for (std::array<std::vector<Triangle>, 6> const& threadTriangles : m_threadTriangles)
+	{
+		for (std::vector<Triangle> const& triangles : threadTriangles)
+		{
+			m_rasterizedTriangleCount += triangles.size();
+		}
+	}
+
+	// Tiles are independent, so each one is cleared and filled by one thread
+	int tileCount = m_tilesPerRow * m_tilesPerRow;
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int task = 0; task < 6 * tileCount; ++task)
+	{
+		rasterizeTile(static_cast<size_t>(task / tileCount), task % tileCount);
+	}
+}
+
+std::vector<float> const& SoftwareShadowMap::getFace(int face) const
+{
+	return m_faces[static_cast<size_t>(face)];
+}
+
+int SoftwareShadowMap::getSize() const
+{
+	return m_size;
+}
+
+size_t SoftwareShadowMap::getTriangleCount() const
+{
+	return m_indices.size() / 3;
+}
+
+size_t SoftwareShadowMap::getRasterizedTriangleCount() const
+{
+	return m_rasterizedTriangleCount;
+}
+
+void SoftwareShadowMap::transformVertex(size_t vertex, std::array<glm::mat4, 6> const& faceViewProjections)
+{
+	glm::vec4 position(m_positions[vertex], 1.f);
+	for (size_t face = 0; face < 6; ++face)
+	{
+		ClipVertex& clipVertex = m_clipVertices[face][vertex];
+		clipVertex.position = faceViewProjections[face] * position;
+
+		// Frustum planes in the order of CLIP_PLANES, followed by the clip planes
+		glm::vec4 const& p = clipVertex.position;
+		float guard = GUARD_BAND * p.w;
+		clipVertex.outcode =
+			(p.z < -p.w ? 0x001u : 0u) | (p.z > p.w ? 0x002u : 0u) |
+			(p.x < -p.w ? 0x004u : 0u) | (p.x > p.w ? 0x008u : 0u) |
+			(p.y < -p.w ? 0x010u : 0u) | (p.y > p.w ? 0x020u : 0u) |
+			(p.z < -p.w ? 0x040u : 0u) | (p.z > p.w ? 0x080u : 0u) |
+			(p.x < -guard ? 0x100u : 0u) | (p.x > guard ? 0x200u : 0u) |
+			(p.y < -guard ? 0x400u : 0u) | (p.y > guard ? 0x800u : 0u);
+	}
+}
+
+void SoftwareShadowMap::setupTriangle(size_t triangle, size_t face, std::vector<Triangle>& triangles) const
+{
+	ClipVertex const& c0 = m_clipVertices[face][m_indices[3 * triangle + 0]];
+	ClipVertex const& c1 = m_clipVertices[face][m_indices[3 * triangle + 1]];
+	ClipVertex const& c2 = m_clipVertices[face][m_indices[3 * triangle + 2]];
+
+	// Reject triangles completely outside of one of the frustum planes
+	if ((c0.outcode & c1.outcode & c2.outcode & 0x3F) != 0)
+	{
+		return;
+	}
+
+	// Most triangles do not need to be clipped
+	uint32_t clipPlanes = (c0.outcode | c1.outcode | c2.outcode) >> 6;
+	if (clipPlanes == 0)
+	{
+		appendTriangle(c0.position, c1.position, c2.position, triangles);
+		return;
+	}
+
+	// The polygon grows by at most one vertex per clip plane
+	std::array<glm::vec4, 9> polygon = { c0.position, c1.position, c2.position };
+	std::array<glm::vec4, 9> clipped;
+	size_t vertexCount = 3;
+
+	// Sutherland-Hodgman clipping against the planes the polygon crosses
+	for (uint32_t plane = 0; plane < 6; ++plane)
+	{
+		if ((clipPlanes & (1u << plane)) == 0)
+		{
+			continue;
+		}
+
+		std::array<float, 9> distances;
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			distances[i] = glm::dot(CLIP_PLANES[plane], polygon[i]);
+		}
+
+		size_t clippedCount = 0;
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			size_t next = (i + 1) % vertexCount;
+			if (distances[i] >= 0.f)
+			{
+				clipped[clippedCount++] = polygon[i];
+			}
+			if ((distances[i] >= 0.f) != (distances[next] >= 0.f))
+			{
+				float t = distances[i] / (distances[i] - distances[next]);
+				clipped[clippedCount++] = polygon[i] + t * (polygon[next] - polygon[i]);
+			}
+		}
+
+		polygon.swap(clipped);
+		vertexCount = clippedCount;
+		if (vertexCount < 3)
+		{
+			return;
+		}
+	}
+
+	for (size_t i = 1; i + 1 < vertexCount; ++i)
+	{
+		appendTriangle(polygon[0], polygon[i], polygon[i + 1], triangles);
+	}
+}
+
+void SoftwareShadowMap::appendTriangle(glm::vec4 const& v0, glm::vec4 const& v1, glm::vec4 const& v2, std::vector<Triangle>& triangles) const
+{
+	// Window coordinates with the default viewport and depth range
+	float halfSize = 0.5f * static_cast<float>(m_size);
+	std::array<glm::vec3, 3> window;
+	glm::vec4 const* clip[3] = { &v0, &v1, &v2 };
+	for (size_t i = 0; i < 3; ++i)
+	{
+		glm::vec3 ndc = glm::vec3(*clip[i]) / clip[i]->w;
+		window[i] = glm::vec3((ndc.x + 1.f) * halfSize, (ndc.y + 1.f) * halfSize, ndc.z * 0.5f + 0.5f);
+	}
+
+	// Counterclockwise triangles have a positive area
+	float area =
+		(window[1].x - window[0].x) * (window[2].y - window[0].y) -
+		(window[2].x - window[0].x) * (window[1].y - window[0].y);
+	if (!(std::abs(area) > 0.f))
+	{
+		return;
+	}
+
+	bool frontFacing = area > 0.f;
+	if ((frontFacing && m_cullFace == CULL_FRONT) || (!frontFacing && m_cullFace == CULL_BACK))
+	{
+		return;
+	}
+
+	// The edge functions expect counterclockwise order
+	if (!frontFacing)
+	{
+		std::swap(window[1], window[2]);
+		area = -area;
+	}
+
+	// Pixels whose center lies within the bounds of the triangle
+	float minX = std::min({ window[0].x, window[1].x, window[2].x });
+	float maxX = std::max({ window[0].x, window[1].x, window[2].x });
+	float minY = std::min({ window[0].y, window[1].y, window[2].y });
+	float maxY = std::max({ window[0].y, window[1].y, window[2].y });
+
+	Triangle triangle;
+	triangle.minX = std::max(static_cast<int>(std::ceil(minX - 0.5f)), 0);
+	triangle.maxX = std::min(static_cast<int>(std::floor(maxX - 0.5f)) + 1, m_size);
+	triangle.minY = std::max(static_cast<int>(std::ceil(minY - 0.5f)), 0);
+	triangle.maxY = std::min(static_cast<int>(std::floor(maxY - 0.5f)) + 1, m_size);
+	if (triangle.minX >= triangle.maxX || triangle.minY >= triangle.maxY)
+	{
+		return;
+	}
+
+	// The edge function of a shared edge is the exact negation of the one of
+	// the neighbour. Pixel centers on the edge are covered by both
+	// triangles, which leaves no gaps and does not change the depth.
+	for (size_t i = 0; i < 3; ++i)
+	{
+		glm::vec3 const& from = window[i];
+		glm::vec3 const& to = window[(i + 1) % 3];
+		triangle.edgeA[i] = from.y - to.y;
+		triangle.edgeB[i] = to.x - from.x;
+		triangle.edgeC[i] = from.x * to.y - to.x * from.y;
+	}
+
+	// Depth gradients in window space
+	float depthX = ((window[1].z - window[0].z) * (window[2].y - window[0].y) - (window[2].z - window[0].z) * (window[1].y - window[0].y)) / area;
+	float depthY = ((window[1].x - window[0].x) * (window[2].z - window[0].z) - (window[2].x - window[0].x) * (window[1].z - window[0].z)) / area;
+
+	// Same offset as glPolygonOffset, using the maximum slope of the triangle
+	float offset = m_polygonOffsetFactor * std::max(std::abs(depthX), std::abs(depthY)) + m_polygonOffsetUnits * DEPTH_RESOLUTION;
+
+	triangle.x0 = window[0].x;
+	triangle.y0 = window[0].y;
+	triangle.depth0 = window[0].z + offset;
+	triangle.depthX = depthX;
+	triangle.depthY = depthY;
+
+	triangles.push_back(triangle);
+}
+
+void SoftwareShadowMap::binTriangles(size_t face)
+{
+	size_t tileCount = static_cast<size_t>(m_tilesPerRow) * static_cast<size_t>(m_tilesPerRow);
+	std::vector<uint32_t>& offsets = m_tileOffsets[face];
+	std::vector<Triangle const*>& tileTriangles = m_tileTriangles[face];
+
+	// Count the triangles of each tile and turn the counts into offsets
+	offsets.assign(tileCount + 1, 0);
+	for (std::array<std::vector<Triangle>, 6> const& threadTriangles : m_threadTriangles)
+	{
+		for (Triangle const& triangle : threadTriangles[face])
+		{
+			for (int tileY = triangle.minY / TILE_SIZE; tileY <= (triangle.maxY - 1) / TILE_SIZE; ++tileY)
+			{
+				for (int tileX = triangle.minX / TILE_SIZE; tileX <= (triangle.maxX - 1) / TILE_SIZE; ++tileX)
+				{
+					offsets[static_cast<size_t>(tileY * m_tilesPerRow + tileX) + 1]++;
+				}
+			}
+		}
+	}
+	for (size_t tile = 0; tile < tileCount; ++tile)
+	{
+		offsets[tile + 1] += offsets[tile];
+	}
+
+	tileTriangles.resize(offsets.back());
+	std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+	for (std::array<std::vector<Triangle>, 6> const& threadTriangles : m_threadTriangles)
+	{
+		for (Triangle const& triangle : threadTriangles[face])
+		{
+			for (int tileY = triangle.minY / TILE_SIZE; tileY <= (triangle.maxY - 1) / TILE_SIZE; ++tileY)
+			{
+				for (int tileX = triangle.minX / TILE_SIZE; tileX <= (triangle.maxX - 1) / TILE_SIZE; ++tileX)
+				{
+					tileTriangles[next[static_cast<size_t>(tileY * m_tilesPerRow + tileX)]++] = &triangle;
+				}
+			}
+		}
+	}
+}
+
+void SoftwareShadowMap::rasterizeTile(size_t face, int tile)
+{
+	float* depth = m_faces[face].data();
+	int tileX = (tile % m_tilesPerRow) * TILE_SIZE;
+	int tileY = (tile / m_tilesPerRow) * TILE_SIZE;
+	int endX = std::min(tileX + TILE_SIZE, m_size);
+	int endY = std::min(tileY + TILE_SIZE, m_size);
+
+	for (int y = tileY; y < endY; ++y)
+	{
+		std::fill(depth + y * m_size + tileX, depth + y * m_size + endX, 1.f);
+	}
+
+	std::vector<uint32_t> const& offsets = m_tileOffsets[face];
+	size_t tileIndex = static_cast<size_t>(tile);
+	for (uint32_t i = offsets[tileIndex]; i < offsets[tileIndex + 1]; ++i)
+	{
+		Triangle const& triangle = *m_tileTriangles[face][i];
+
+		// Bounds of the triangle within the tile
+		int startX = std::max(triangle.minX, tileX);
+		int stopX = std::min(triangle.maxX, endX);
+		int startY = std::max(triangle.minY, tileY);
+		int stopY = std::min(triangle.maxY, endY);
+
+#ifdef SOFTWARE_SHADOW_MAP_SSE2
+		__m128 const pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		__m128 const zero = _mm_setzero_ps();
+		__m128 const one = _mm_set1_ps(1.f);
+		__m128 const edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+		__m128 const edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+		__m128 const edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+		__m128 const depthX = _mm_set1_ps(triangle.depthX);
+		__m128 const x0 = _mm_set1_ps(triangle.x0);
+#endif
+
+		for (int y = startY; y < stopY; ++y)
+		{
+			float py = static_cast<float>(y) + 0.5f;
+			std::array<float, 3> rowEdges;
+			for (size_t edge = 0; edge < 3; ++edge)
+			{
+				rowEdges[edge] = triangle.edgeB[edge] * py + triangle.edgeC[edge];
+			}
+			float rowDepth = triangle.depth0 + triangle.depthY * (py - triangle.y0);
+			float* row = depth + y * m_size;
+
+			// Conservative span of the row, the edge tests below are exact
+			float spanStart = static_cast<float>(startX);
+			float spanStop = static_cast<float>(stopX);
+			for (size_t edge = 0; edge < 3; ++edge)
+			{
+				float crossing = -rowEdges[edge] / triangle.edgeA[edge] - 0.5f;
+				if (triangle.edgeA[edge] > 0.f)
+				{
+					spanStart = std::max(spanStart, crossing - 1.f);
+				}
+				else if (triangle.edgeA[edge] < 0.f)
+				{
+					spanStop = std::min(spanStop, crossing + 2.f);
+				}
+				else if (rowEdges[edge] < 0.f)
+				{
+					spanStop = spanStart;
+				}
+			}
+			if (!(spanStart < spanStop))
+			{
+				continue;
+			}
+			int spanStartX = static_cast<int>(spanStart);
+			int spanStopX = static_cast<int>(spanStop);
+
+#ifdef SOFTWARE_SHADOW_MAP_SSE2
+			__m128 const row0 = _mm_set1_ps(rowEdges[0]);
+			__m128 const row1 = _mm_set1_ps(rowEdges[1]);
+			__m128 const row2 = _mm_set1_ps(rowEdges[2]);
+			__m128 const rowDepths = _mm_set1_ps(rowDepth);
+
+			// Groups of four pixels aligned to the tile
+			for (int x = spanStartX & ~3; x < spanStopX; x += 4)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), pixelOffsets);
+				__m128 edge0 = _mm_add_ps(_mm_mul_ps(edgeA0, px), row0);
+				__m128 edge1 = _mm_add_ps(_mm_mul_ps(edgeA1, px), row1);
+				__m128 edge2 = _mm_add_ps(_mm_mul_ps(edgeA2, px), row2);
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				// Offset depth clamped to the depth range, stored if less
+				__m128 z = _mm_add_ps(rowDepths, _mm_mul_ps(depthX, _mm_sub_ps(px, x0)));
+				z = _mm_min_ps(_mm_max_ps(z, zero), one);
+				__m128 stored = _mm_loadu_ps(row + x);
+				__m128 write = _mm_and_ps(inside, _mm_cmplt_ps(z, stored));
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(write, z), _mm_andnot_ps(write, stored)));
+			}
+#else
+			for (int x = spanStartX; x < spanStopX; ++x)
+			{
+				float px = static_cast<float>(x) + 0.5f;
+				if (triangle.edgeA[0] * px + rowEdges[0] < 0.f || triangle.edgeA[1] * px + rowEdges[1] < 0.f || triangle.edgeA[2] * px + rowEdges[2] < 0.f)
+				{
+					continue;
+				}
+
+				// Offset depth clamped to the depth range, stored if less
+				float z = std::min(std::max(rowDepth + triangle.depthX * (px - triangle.x0), 0.f), 1.f);
+				row[x] = std::min(row[x], z);
+			}
+#endif
+		}
+	}
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+
+// Depth only triangle rasterizer which renders the six faces of a cube
+// shadow map on the CPU. The faces are rendered with the view projections
+// of glUtil::ShadowMap and hold window space depth like a depth texture
+// rendered by OpenGL, with the depth offset of glPolygonOffset for a 24 bit
+// depth buffer. Triangles are set up and binned into tiles in parallel and
+// each tile is rasterized by one thread, four pixels at a time.
+class SoftwareShadowMap
+{
+public:
+	// Faces which are removed before rasterization, see glCullFace
+	enum CullFace
+	{
+		CULL_NONE,
+		CULL_BACK, // counterclockwise triangles in window space are front facing
+		CULL_FRONT,
+	};
+
+	SoftwareShadowMap();
+
+	// Allocates the depth of the six faces. The size must be a multiple of 4.
+	void init(int size);
+
+	// Removes all triangles
+	void clear();
+
+	// Adds the triangles of an indexed mesh. The positions are read from
+	// vertexCount elements which are stride bytes apart and transformed
+	// into world space by the model matrix.
+	void addMesh(
+		glm::vec3 const* positions,
+		size_t stride,
+		size_t vertexCount,
+		std::vector<uint32_t> const& indices,
+		glm::mat4 const& modelMatrix
+	);
+
+	// Same parameters as glPolygonOffset
+	void setPolygonOffset(float factor, float units);
+	void setCullFace(CullFace cullFace);
+
+	// Clears the faces to the far plane and renders all triangles. Face i
+	// is the face GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, its view projection
+	// transforms world space into its clip space.
+	void render(std::array<glm::mat4, 6> const& faceViewProjections);
+
+	// Returns the window space depth of a face. Rows start at the bottom like
+	// the data expected by glTexSubImage2D.
+	std::vector<float> const& getFace(int face) const;
+
+	int getSize() const;
+
+	// Number of triangles added since the last clear()
+	size_t getTriangleCount() const;
+
+	// Number of triangles which reached the rasterizer in the last render(),
+	// summed over all faces. Clipped triangles may count more than once.
+	size_t getRasterizedTriangleCount() const;
+
+private:
+	// A vertex in the clip space of one face
+	struct ClipVertex
+	{
+		glm::vec4 position;
+		uint32_t outcode; // bit i is set if the vertex is outside of frustum plane i, bit 6 + i for clip plane i
+	};
+
+	// A triangle set up for one face
+	struct Triangle
+	{
+		// Window space bounds, clamped to the face
+		int minX;
+		int minY;
+		int maxX; // exclusive
+		int maxY; // exclusive
+
+		// Edge functions a * x + b * y + c, positive inside
+		std::array<float, 3> edgeA;
+		std::array<float, 3> edgeB;
+		std::array<float, 3> edgeC;
+
+		// Depth plane relative to the first vertex, including the offset
+		float x0;
+		float y0;
+		float depth0;
+		float depthX;
+		float depthY;
+	};
+
+	// Transforms the vertex into the clip space of each face
+	void transformVertex(size_t vertex, std::array<glm::mat4, 6> const& faceViewProjections);
+
+	// Clips the triangle against the planes of the view frustum which it
+	// crosses and appends the resulting triangles
+	void setupTriangle(size_t triangle, size_t face, std::vector<Triangle>& triangles) const;
+
+	// Projects a clipped triangle into window space, culls it and appends
+	// its setup if it covers the face
+	void appendTriangle(glm::vec4 const& v0, glm::vec4 const& v1, glm::vec4 const& v2, std::vector<Triangle>& triangles) const;
+
+	// Sorts the triangles of all threads into the tiles of the face
+	void binTriangles(size_t face);
+
+	// Clears the tile and rasterizes all triangles binned into it
+	void rasterizeTile(size_t face, int tile);
+
+	static int const TILE_SIZE = 64;
+
+	int m_size;
+	int m_tilesPerRow;
+	std::array<std::vector<float>, 6> m_faces;
+
+	// World space triangles
+	std::vector<glm::vec3> m_positions;
+	std::vector<uint32_t> m_indices;
+
+	float m_polygonOffsetFactor;
+	float m_polygonOffsetUnits;
+	CullFace m_cullFace;
+
+	// Vertices of the current render() in the clip space of each face
+	std::array<std::vector<ClipVertex>, 6> m_clipVertices;
+
+	// Triangles set up by each thread, per face
+	std::vector<std::array<std::vector<Triangle>, 6>> m_threadTriangles;
+
+	// Triangles overlapping each tile of a face. The triangles of tile i
+	// are m_tileTriangles[face][m_tileOffsets[face][i]] up to the offset
+	// of tile i + 1.
+	std::array<std::vector<uint32_t>, 6> m_tileOffsets;
+	std::array<std::vector<Triangle const*>, 6> m_tileTriangles;
+
+	size_t m_rasterizedTriangleCount;
+};